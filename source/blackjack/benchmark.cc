@@ -0,0 +1,226 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module blackjack:benchmark;
+import :card;
+import :game;
+import :player;
+
+import std.core;
+import std.filesystem;
+import tornasol;
+
+using namespace std;
+using namespace std::filesystem;
+using namespace tornasol;
+
+export namespace blackjack {
+
+    // Renders a scripted table for a fixed number of frames and reports
+    // frame time percentiles and draw calls, meant for build agents:
+    //
+    //   blackjack bench 1000 osmesa low 4
+    i32 run_benchmark(u32 frames, window_backend backend, 
+        quality_preset preset = quality_preset::high, u32 tables = 1)
+    {
+        glfw_dep glfw;
+        glad_dep glad(glfw.proc());
+
+        render_quality quality = get_quality(preset);
+        window window("blackjack benchmark", {1280, 720}, false, backend,
+            quality.get_window_samples());
+        window.show();
+        input input(window.get_handle(), window.get_input_queue());
+        renderer renderer(glad, window, quality);
+
+        game game(tables);
+
+        // streaming is not what we measure, let it finish first
+        while (game.is_loading())
+            game.render(renderer);
+
+        const player_state script[] = {
+            player_state::wait, player_state::play, player_state::win,
+            player_state::lose, player_state::push, player_state::bust,
+            player_state::blackjack, player_state::idle
+        };
+
+        vector<f64> times;
+        times.reserve(frames);
+        render_stats before = renderer.get_stats();
+        arena_stats arena_before = get_arena_stats();
+
+        for (u32 i = 0; i < frames; ++i)
+        {
+            // cycle the seats through every state, so labels keep changing
+            if (i % 30 == 0)
+            {
+                for (auto& t : game.get_tables())
+                {
+                    auto& players = t->get_players();
+                    for (usize j = 0; j < players.size(); ++j)
+                        players[j].set_state(
+                            script[(i / 30 + j) % size(script)]);
+                }
+            }
+
+            u64 start = profiler_now();
+            input.update();
+            game.update(input, 1.0 / 60.0); // one logic step per frame
+            game.render(renderer);
+            times.push_back((profiler_now() - start) / 1e6);
+
+            pull_events();
+        }
+
+        if (times.empty())
+            return 0;
+
+        render_stats after = renderer.get_stats();
+        arena_stats arena_after = get_arena_stats();
+        u64 calls = after.calls - before.calls;
+        u64 changes = after.state_changes - before.state_changes;
+        u64 elided = after.elided - before.elided;
+        u64 opaque = after.opaque - before.opaque;
+        ranges::sort(times);
+
+        auto percentile = [&times](f64 p) {
+            return times[usize(p * (times.size() - 1))];
+        };
+
+        f64 total = 0;
+        for (f64 t : times)
+            total += t;
+
+        size2<i32> size = renderer.get_render_size();
+        print("frames: {}, {}, tables: {}", frames, 
+            renderer.is_offscreen() ? "offscreen" : "onscreen", tables);
+        print("render size: {}x{}, msaa {}x, fxaa {}", size.w, size.h, 
+            quality.samples, quality.fxaa ? "on" : "off");
+        print("frame ms: avg {:.3f} p50 {:.3f} p90 {:.3f} p99 {:.3f} max {:.3f}",
+            total / times.size(), percentile(0.5), percentile(0.9), 
+            percentile(0.99), times.back());
+        print("draw calls per frame: {:.1f}", f64(calls) / frames);
+        print("state changes per frame: {:.1f}, elided {:.1f}", 
+            f64(changes) / frames, f64(elided) / frames);
+        print("opaque sprites per frame: {:.1f}, overdraw {:.2f}", 
+            f64(opaque) / frames, after.overdraw);
+        // only what goes through the frame arenas, other heap use is not 
+        // counted
+        print("frame arena per frame: {:.1f} allocations, {:.0f} bytes, "
+            "{} heap chunks in total, peak {} bytes", 
+            f64(arena_after.allocations - arena_before.allocations) / frames,
+            f64(arena_after.bytes - arena_before.bytes) / frames,
+            arena_after.heap_allocations, get_frame_arena().get_peak());
+
+        return 0;
+    }
+
+    // Spreads count card sprites over the screen, turns all of them every
+    // frame and reports what the registry systems cost:
+    //
+    //   blackjack bench-entities 10000 300 osmesa
+    i32 run_entity_benchmark(u32 count, u32 frames, window_backend backend)
+    {
+        glfw_dep glfw;
+        glad_dep glad(glfw.proc());
+
+        window window("blackjack benchmark", {1280, 720}, false, backend);
+        window.show();
+        renderer renderer(glad, window);
+
+        asset_manager assets;
+        assets.mount(path(L"./content.pack"));
+        registry entities;
+
+        mt19937 rng(42);
+        uniform_real_distribution<f32> x(0.0f, 1280.0f);
+        uniform_real_distribution<f32> y(0.0f, 720.0f);
+        uniform_int_distribution<u32> num(1, 12);
+        uniform_int_distribution<u32> suit(1, 4);
+
+        vector<entity_id> ids;
+        ids.reserve(count);
+
+        for (u32 i = 0; i < count; ++i)
+        {
+            entity_id id = entities.create(component_transform 
+                | component_sprite | component_hitbox);
+
+            string name = to_string(num(rng)) 
+                + suit_name((card_suit)suit(rng))[0];
+            entities.get_sprite(id).texture = assets.get_texture(
+                path("./content/cards/" + name + ".png"));
+
+            ts::transform& t = entities.get_transform(id);
+            t.pos = { x(rng), y(rng), 0.0f };
+            t.sca = { 0.25f, 0.25f, 1.0f };
+            ids.push_back(id);
+        }
+
+        while (assets.is_busy())
+            assets.update(1.0);
+
+        vector<f64> update_times;
+        vector<f64> render_times;
+        update_times.reserve(frames);
+        render_times.reserve(frames);
+
+        for (u32 i = 0; i < frames; ++i)
+        {
+            for (entity_id id : ids)
+                entities.get_transform(id).rot.z += 0.01f;
+
+            u64 start = profiler_now();
+            entities.update();
+            u64 mid = profiler_now();
+
+            renderer.clear(0x095b43ff);
+            entities.render(renderer);
+            renderer.present();
+            u64 end = profiler_now();
+
+            update_times.push_back((mid - start) / 1e6);
+            render_times.push_back((end - mid) / 1e6);
+            pull_events();
+        }
+
+        if (frames == 0)
+            return 0;
+
+        auto report = [](string_view name, vector<f64>& times) {
+            ranges::sort(times);
+
+            f64 total = 0;
+            for (f64 t : times)
+                total += t;
+
+            print("{} ms: avg {:.3f} p50 {:.3f} p99 {:.3f}", name, 
+                total / times.size(), times[times.size() / 2], 
+                times[usize(0.99 * (times.size() - 1))]);
+        };
+
+        print("entities: {}, frames: {}", entities.get_size(), frames);
+        report("update", update_times);
+        report("render", render_times);
+
+        return 0;
+    }
+}
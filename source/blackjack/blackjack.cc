@@ -20,12 +20,17 @@
 
 export module blackjack;
 
+export import :benchmark;
 export import :button;
 export import :card;
 export import :client;
+export import :cooker;
 export import :dealer;
+export import :deck;
 export import :def;
 export import :game;
 export import :hand;
 export import :image;
-export import :server;
\ No newline at end of file
+export import :server;
+export import :table;
+export import :text;
\ No newline at end of file
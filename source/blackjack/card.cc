@@ -19,6 +19,7 @@
 */
 
 export module blackjack:card;
+import :def;
 import std.core;
 import std.filesystem;
 import tornasol;
@@ -64,27 +65,32 @@ export namespace blackjack {
         }
     }
 
-    class card : public entity {
+    fs::path card_path(u8 num, card_suit suit) 
+    {
+        string tmp = to_string(num) + suit_name(suit)[0];
+        wstring card_name(tmp.begin(), tmp.end());
+        return fs::path(L"./content/cards/" + card_name + L".png");
+    }
+
+    class card {
     private:
-        texture_renderer tex;
+        static constexpr f32 scale = 0.80f;
+        static constexpr f32 flip_time = 0.30f;
+
+        scoped_entity ent;
         u8 num;
         card_suit suit;
+        bool face_up;
         
     public:
-        card(u8 num, card_suit suit)
-            : num(num), suit(suit)
+        // A blank card, hidden until it is dealt, see reset().
+        card(registry& reg, i32 layer = layer_cards)
+            : ent(reg, component_transform | component_sprite 
+                | component_hitbox, layer), 
+              num(0), suit(card_suit::back), face_up(false)
         {
-            string tmp = to_string(num) + suit_name(suit)[0];
-            wstring card_name(tmp.begin(), tmp.end());
-            fs::path path(L"./content/cards/" + card_name + L".png");
-
-            image image(path);
-
-            tex.set_rect({ (f32)image.width, (f32)image.height });
-            tex.set_image(image);
-
-            trans.sca = { 0.80f, 0.80f, 0.80f };
-            tex.set_model(trans.get_mat());
+            ent.get_transform().sca = { scale, scale, scale };
+            ent.get_sprite().visible = false;
         }
 
         // non-default-constructible
@@ -95,22 +101,8 @@ export namespace blackjack {
         card& operator=(const card& other) = delete;
 
         // movable
-        card(card&& other)
-            : entity(move(other))
-            , tex(move(other.tex))
-            , num(other.num)
-            , suit(other.suit)
-        {
-        }
-
-        card& operator = (card&& other) 
-        {
-            entity::operator=(move(other));
-            tex = move(other.tex);
-            num = other.num;
-            suit = other.suit;
-            return *this;
-        }
+        card(card&& other) = default;
+        card& operator=(card&& other) = default;
 
         u8 get_num() const {
             return num;
@@ -120,6 +112,84 @@ export namespace blackjack {
             return suit; 
         }
 
+        bool is_face_up() const {
+            return face_up;
+        }
+
+        entity_id get_id() const {
+            return ent.get_id();
+        }
+
+        // Turns the card into another one, shown with the texture of the 
+        // side facing up, squared and unparented.
+        void reset(shared<texture> side, u8 num, card_suit suit, 
+            bool face_up = true)
+        {
+            this->num = num;
+            this->suit = suit;
+            this->face_up = face_up;
+
+            ts::transform& t = ent.get_transform();
+            t.rot = { 0.0f, 0.0f, 0.0f };
+            t.sca = { scale, scale, scale };
+            ent.set_parent(null_entity);
+
+            sprite& s = ent.get_sprite();
+            s.texture = move(side);
+            s.depth = 0;
+            s.visible = true;
+        }
+
+        // shows a texture without changing which side is up, e.g. a back 
+        // until the card is revealed
+        void set_side(shared<texture> side) {
+            ent.get_sprite().texture = move(side);
+        }
+
+        bool is_visible() const {
+            return ent.get_sprite().visible;
+        }
+
+        void set_visible(bool value) {
+            ent.get_sprite().visible = value;
+        }
+
+        ts::transform& get_transform() {
+            return ent.get_transform();
+        }
+
+        const ts::transform& get_transform() const {
+            return ent.get_transform();
+        }
+
+        // position becomes relative to the parent's
+        void set_parent(entity_id parent) {
+            ent.set_parent(parent);
+        }
+
+        // Turns the card over: squeezes it to its edge, swaps to the 
+        // texture of the other side and widens it back.
+        void flip(tween_system& tweens, shared<texture> side, 
+            f32 delay = 0.0f)
+        {
+            face_up = !face_up;
+
+            const vec3<> full = { scale, scale, scale };
+            const vec3<> edge = { 0.0f, scale, scale };
+            const f32 half = flip_time / 2.0f;
+
+            tweens.cancel(get_id(), tween_channel::scale);
+            tweens.add(get_id(), tween_channel::scale, full, edge, half, 
+                easing::quad_in, delay);
+            tweens.add(get_id(), tween_channel::scale, edge, full, half, 
+                easing::quad_out, delay + half, move(side));
+        }
+
+        // later cards of a hand overlap earlier ones
+        void set_depth(u16 depth) {
+            ent.get_sprite().depth = depth;
+        }
+
         i32 get_value() const 
         {
             if (suit == card_suit::back || suit == card_suit::joker)
@@ -133,14 +203,5 @@ export namespace blackjack {
 
             return num;
         }
-
-        void render(renderer& renderer) override 
-        {
-            if (!enable) 
-                return;
-            
-            tex.set_model(trans.get_mat());
-            renderer.render(tex);
-        }       
     };
-}
\ No newline at end of file
+}
@@ -157,7 +157,11 @@ export namespace blackjack {
         return 0;
     }
     */
-    i32 run_client2() 
+    // The quality preset trades resolution and anti-aliasing for speed, 
+    // see render_quality. Several tables can be played at once, they 
+    // share the window.
+    i32 run_client2(quality_preset preset = quality_preset::high, 
+        u32 tables = 1) 
     {
         // declare deps
         glfw_dep glfw;
@@ -166,36 +170,66 @@ export namespace blackjack {
         bool exit_requested = false;
 
         // setup main window & input     
-        window window("blackjack", {1280, 720}, false);
+        render_quality quality = get_quality(preset);
+        window window("blackjack", {1280, 720}, false, 
+            window_backend::native, quality.get_window_samples());
         window.on_close = [&exit_requested]() { 
             exit_requested = true; 
         };
         window.show();
-        input input(window.get_handle());
+        input input(window.get_handle(), window.get_input_queue());
 
         // setup renderer
-        renderer renderer(glad, window);
+        renderer renderer(glad, window, quality);
+
+        // setup frame pacing, vsync and only redraw when something changed
+        frame_scheduler scheduler(window);
+
+        // setup profiler, F12 dumps the recorded frames for chrome://tracing
+        profiler profiler;
+        gpu_timer render_timer(profiler, "gpu::render");
+        window.on_key = [&profiler](key k, i32, key_action a, key_mod) {
+            if (k == key::f12 && a == key_action::press)
+                profiler.write_chrome_trace("./trace.json");
+        };
         
         // setup game
-        game* game = new blackjack::game();
+        game* game = new blackjack::game(tables);
+
+        // game logic ticks at a fixed rate on its own thread, the main 
+        // thread only pumps events and draws the latest published table
+        logic_thread logic(1.0 / 60.0, [&](f64 dt) {
+            profile_scope scope(profiler, "game::update");
+            input.update();
+            game->update(input, dt);
+        });
+        logic.start();
         
         // main loop
         while (!exit_requested)
         {
+            scheduler.wait();
+            logic.check();
+
             if (window.key_pressed(key::escape))
                 exit_requested = true;
 
             if (window.key_pressed(key::r)) {
-                delete game;
-                game = new blackjack::game();
+                logic.stop();
+                game->reset();
+                logic.start();
             }
 
-            game->update(input);
-            game->render(renderer);
+            {
+                profile_scope scope(profiler, "game::render");
+                gpu_scope gpu(render_timer);
+                game->render(renderer);
+            }
 
-            pull_events();
+            profiler.end_frame();
         }
 
+        logic.stop();
         delete game;
         return 0;
     }
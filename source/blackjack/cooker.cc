@@ -0,0 +1,96 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module blackjack:cooker;
+import :def;
+import :text;
+
+import std.core;
+import std.filesystem;
+import tornasol;
+
+using namespace std;
+using namespace tornasol;
+
+namespace fs = std::filesystem;
+
+export namespace blackjack {
+
+    // Offline step: decodes every png under the given directories once and
+    // writes them, premultiplied and with their mip chains, into a single 
+    // pack the client maps at startup.
+    //
+    //   blackjack cook ./content.pack ./content/cards ./content/game ...
+    i32 run_cooker(fs::path out, const vector<fs::path>& sources)
+    {
+        pack_writer writer;
+        usize bytes = 0;
+
+        for (auto& dir : sources)
+        for (auto& file : fs::recursive_directory_iterator(dir))
+        {
+            if (!file.is_regular_file() || file.path().extension() != ".png")
+                continue;
+
+            image rgba = to_rgba(image(file.path()));
+            premultiply_alpha(rgba);
+
+            vector<image> levels = build_mip_chain(move(rgba));
+            for (auto& level : levels)
+                bytes += level.get_size();
+
+            writer.add_texture(file.path(), levels, true);
+        }
+
+        // the distance field font is baked here too, straight alpha
+        vector<image> font_levels = build_mip_chain(bake_segment_font());
+        for (auto& level : font_levels)
+            bytes += level.get_size();
+
+        writer.add_texture(font_path, font_levels, false);
+
+        writer.write(out);
+
+        print("cooked {} textures ({} kb) into {}", 
+            writer.get_count(), bytes / 1024, out.string());
+
+        return 0;
+    }
+
+    // Same as run_cooker but stores the files untouched, they are decoded
+    // from the mapped pack at runtime. Smaller on disk, slower to load.
+    //
+    //   blackjack pack ./content.pack ./content/cards ./content/game ...
+    i32 run_packer(fs::path out, const vector<fs::path>& sources)
+    {
+        pack_writer writer;
+
+        for (auto& dir : sources)
+        for (auto& file : fs::recursive_directory_iterator(dir))
+            if (file.is_regular_file())
+                writer.add_raw(file.path());
+
+        writer.write(out);
+
+        print("packed {} files into {}", writer.get_count(), out.string());
+
+        return 0;
+    }
+}
\ No newline at end of file
@@ -25,11 +25,12 @@ export namespace blackjack {
 
     class dealer : public player {
     public:
-        dealer()
-            : player(1, false)
+        dealer(asset_manager& assets, registry& reg, tween_system& tweens,
+            deck& cards, font& fnt)
+            : player(assets, reg, tweens, cards, fnt, 1, false)
         {
-            label.enable = false;
-            placeholder.enable = false;
+            label.set_visible(false);
+            placeholder.set_visible(false);
         }
     };
 }
\ No newline at end of file
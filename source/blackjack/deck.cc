@@ -0,0 +1,111 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module blackjack:deck;
+import :card;
+import std.core;
+import tornasol;
+
+using namespace std;
+using namespace tornasol;
+
+export namespace blackjack {
+
+    // Every card a table ever dealt, kept in a pool and dealt again once 
+    // collected, so a round creates no entities and no textures. Faces 
+    // are looked up once each and held.
+    class deck {
+    private:
+        // enough for four seats and the dealer to hit a few times
+        static constexpr usize initial_capacity = 64;
+
+        asset_manager& assets;
+        registry& reg;
+        pool<card> cards;
+        array<shared<texture>, 6 * 14> faces; // by suit, then number
+
+    public:
+        deck(asset_manager& assets, registry& reg)
+            : assets(assets), reg(reg), cards(initial_capacity) {}
+
+        // non-copyable
+        deck(const deck&) = delete;
+        deck& operator=(const deck&) = delete;
+
+        // texture of a card's face, the back for card_suit::back
+        const shared<texture>& get_face(u8 num, card_suit suit)
+        {
+            if (suit == card_suit::back)
+                num = 3;
+
+            shared<texture>& face = faces[(usize)suit * 14 + num % 14];
+            if (!face)
+                face = assets.get_texture(card_path(num, suit));
+
+            return face;
+        }
+
+        // texture of the side of the card facing up
+        const shared<texture>& get_side(const card& c) 
+        {
+            return c.is_face_up() 
+                ? get_face(c.get_num(), c.get_suit())
+                : get_face(0, card_suit::back);
+        }
+
+        // A card from the pool, visible and at the root of the registry.
+        pool_handle deal(u8 num, card_suit suit, bool face_up = true)
+        {
+            pool_handle h = cards.acquire(reg);
+            cards[h].reset(face_up 
+                ? get_face(num, suit) : get_face(0, card_suit::back), 
+                num, suit, face_up);
+            return h;
+        }
+
+        // Hides the card and puts it back, its tweens must be done or
+        // cancelled.
+        void collect(pool_handle h)
+        {
+            if (card* c = cards.find(h)) {
+                c->set_visible(false);
+                c->set_parent(null_entity);
+                cards.release(h);
+            }
+        }
+
+        card& operator[](pool_handle h) {
+            return cards[h];
+        }
+
+        const card& operator[](pool_handle h) const {
+            return cards[h];
+        }
+
+        // cards on the table, and cards ever made
+        usize get_size() const {
+            return cards.get_size();
+        }
+
+        usize get_capacity() const {
+            return cards.get_capacity();
+        }
+    };
+}
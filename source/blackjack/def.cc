@@ -43,6 +43,16 @@ namespace blackjack {
     using ts::shared;
     using ts::weak;
     using ts::unique;
+
+    // draw order of the table, also decides who takes the pointer
+    enum layer : i32
+    {
+        layer_background,
+        layer_table,   // labels, placeholders
+        layer_cards,
+        layer_buttons,
+        layer_overlay  // busted, blackjack decor
+    };
 }
 
 export 
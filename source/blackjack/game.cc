@@ -20,11 +20,9 @@
 
 export module blackjack:game;
 
-import :button;
-import :hand;
-import :card;
-import :dealer;
-import :player;
+import :def;
+import :table;
+import :text;
 import std.core;
 import std.filesystem;
 import tornasol;
@@ -35,86 +33,153 @@ using namespace tornasol;
 
 export namespace blackjack {
 
+    // The client's view: one or more tables laid out in a grid over the 
+    // window. They share the assets, the font and one frame of commands,
+    // sorted by layer across tables, so e.g. every background is drawn 
+    // in one batch.
     class game {
     private:
+        // time spent uploading streamed textures per frame, in seconds
+        static constexpr f64 upload_budget = 0.004;
+
+        // assets
+        asset_manager assets;
+        atomic<bool> loading;
+        font fnt; // totals
+
+        // what update() last recorded, submitted by render() on the gl 
+        // thread
+        triple_buffer<command_list> frames;
+        u64 published;
+        command_queue queue;
+
+        // the backgrounds and seats go to a framebuffer, redrawn only when
+        // one of them changes
+        layer_cache statics;
+
         // components
         color bg_color;
-        texture_renderer bg; // background
         texture_renderer ls; // loading screen
-        vector<player> players;
-        dealer dea;
-
-        // rng
-        random_device dev;
-        mt19937 rng;
+        vector<unique<table>> tables;
 
     public:
-        game()
-            : rng(dev())
+        game(u32 table_count = 1)
+            : assets(path(L"./content.pack")), loading(true), 
+              fnt(load_font_atlas(assets)), published(0), 
+              statics(layer_table), bg_color(0x095b43ff)
         {
-            // setup game background
-            image bg_img = image(path(L"./content/game/background.png"));
-            image ls_img = image(path(L"./content/game/loading_screen.png"));
-
-            bg_color = 0x095b43ff;
-            bg.set_rect({ (f32)bg_img.width, (f32)bg_img.height });
-            bg.set_image(bg_img);
+            // the loading screen is decoded right away, it is shown while
+            // everything else streams in
+            image ls_img = 
+                assets.read_image(path(L"./content/game/loading_screen.png"));
 
             ls.set_rect({ (f32)ls_img.width, (f32)ls_img.height });
             ls.set_image(ls_img);
 
-            // setup players
-            players.emplace_back(1);
-            players.emplace_back(2);
-            players.emplace_back(3, true);
-            players.emplace_back(4);
+            // setup tables
+            tables.reserve(table_count);
+            for (u32 i = 0; i < std::max(table_count, 1u); ++i)
+                tables.push_back(make_unique<table>(assets, fnt));
+
+            layout();
+        }
 
-            uniform_int_distribution<u32> num_dist(1, 12);
-            uniform_int_distribution<u32> suit_dist(1, 4);
+        bool is_loading() const {
+            return loading;
+        }
 
-            for (i32 i = 0; i < 4; ++i)
-            {
-                auto& p = players[i];
+        vector<unique<table>>& get_tables() {
+            return tables;
+        }
+
+        // Lays the tables out in a grid over the design resolution, each 
+        // scaled down to fit its cell, centered in it.
+        void layout()
+        {
+            const size2<i32> design = camera::default_design;
+            const u32 n = (u32)tables.size();
+            const u32 cols = (u32)ceil(sqrt((f32)n));
+            const u32 rows = (n + cols - 1) / cols;
+
+            const f32 cell_w = (f32)design.w / (f32)cols;
+            const f32 cell_h = (f32)design.h / (f32)rows;
+            const f32 s = min(cell_w / table::width, cell_h / table::height);
 
-                p.trans.pos = vec3<>{ 70, 325, 0 } + f32(i) * vec3<>{320, 0, 0};
-                
-                p.add_card(num_dist(rng), (card_suit)suit_dist(rng));
-                p.add_card(num_dist(rng), (card_suit)suit_dist(rng));
+            for (u32 i = 0; i < n; ++i)
+            {
+                vec3<> origin = { 
+                    (f32)(i % cols) * cell_w + (cell_w - table::width * s) / 2,
+                    (f32)(i / cols) * cell_h + (cell_h - table::height * s) / 2,
+                    0.0f 
+                };
+
+                mat4<> view(1.0f);
+                translate(view, origin);
+                ts::scale(view, { s, s, 1.0f });
+                tables[i]->set_view(view);
             }
+        }
 
-            // setup dealer
-            dea.trans.pos = { 560.0f, -40.0f, 0.0f };
-            //dea.add_card(num_dist(rng), (card_suit)suit_dist(rng));
-            //dea.add_card(num_dist(rng), (card_suit)suit_dist(rng));
-            //dea.add_card(3, card_suit::back);
-            dea.add_card(1,  (card_suit)suit_dist(rng));
-            dea.add_card(1,  (card_suit)suit_dist(rng));
-            dea.add_card(4,  (card_suit)suit_dist(rng));
-            dea.add_card(10, (card_suit)suit_dist(rng));
-            dea.add_card(1,  (card_suit)suit_dist(rng));
-            
+        // Starts every table over, nothing is reloaded or recreated. Not 
+        // while update() runs.
+        void reset()
+        {
+            for (auto& t : tables)
+                t->reset();
         }
 
-        void update(const input& in)
+        // Game logic, may run on its own thread. Advances by the fixed 
+        // step dt, the input only brings edges and the cursor. Widgets pick
+        // against the hitboxes of the last tick, which is what is on screen.
+        void update(const input& in, f64 dt)
         {
-            for (auto& p : players)
-                p.update(in);
+            // nothing moves until the tables are on screen
+            if (loading)
+                return;
+
+            vec2<> cursor = in.cursor_pos();
+            for (auto& t : tables)
+                t->update(in, dt, tables.size() == 1 || t->contains(cursor));
+
+            // publish only when a table changed, idle frames stay idle
+            command_list& frame = frames.write();
+            frame.reset();
+
+            for (auto& t : tables)
+                t->record(frame);
+
+            if (frame.get_hash() != published)
+            {
+                published = frame.get_hash();
+                frames.publish();
+                request_redraw();
+            }
         }
 
         void render(renderer& renderer)
         {   
-            // render background
-            renderer.clear(bg_color);
-            renderer.render(bg);
+            assets.update(upload_budget);
+            loading = loading && assets.is_busy();
 
-            // render dealer & players            
-            for (auto& p : players)
-                p.render(renderer);
+            // keep drawing while textures stream in
+            if (assets.is_busy())
+                request_redraw();
 
-            dea.render(renderer);
+            if (loading) 
+            {
+                renderer.clear(bg_color);
+                renderer.render(ls);
+                renderer.present();
+                return;
+            }
+
+            // render the latest tables, backgrounds to overlays
+            frames.acquire();
+            renderer.clear(bg_color);
+            statics.submit(renderer, queue, frames.read(), bg_color);
 
             // present
             renderer.present();
         }
     };
-}
\ No newline at end of file
+}
@@ -22,48 +22,210 @@ export module blackjack:hand;
 import std.core;
 import tornasol;
 import :card;
+import :deck;
 using namespace std;
 using namespace tornasol;
 
 export namespace blackjack { 
 
-    class hand : public entity {
+    // The cards of a seat. They are borrowed from the table's deck and 
+    // handed back once they reach the pile, the hand keeps handles only.
+    class hand {
     private:
-        vector<card> cards;
+        static constexpr f32 move_time = 0.35f;
+        static constexpr usize typical_size = 12;
 
-    public:            
+        deck* stock;
+        vector<pool_handle> cards;
+        vector<vec3<>> jitter; // x, y offsets and tilt, rolled once per card
+        vector<pool_handle> discards; // collected, on their way to the pile
+        scoped_entity node; // pivot of the arrangement, parent of the cards
+        mt19937 rng;
+        i32 side;
+
+        // where a card of the arrangement rests
+        ts::transform slot(usize i)
+        {
+            i32 offset = 50 - (5 * (i32)cards.size());
+            offset = max(offset, 30);
+            i32 stride = offset * (i32)i;
+
+            ts::transform t = (*stock)[cards[i]].get_transform();
+            t.pos.x = stride + side * jitter[i].x;
+            t.pos.y = side * jitter[i].y;
+            t.rot.z = side * jitter[i].z;
+            return t;
+        }
+
+    public:
+        vec3<> shoe; // where dealt cards wait, table coordinates, top right
+
+        hand(registry& reg, deck& stock) 
+            : stock(&stock), node(reg, component_transform), 
+              rng(random_device()()), shoe(1100.0f, 20.0f, 0.0f)
+        {
+            cards.reserve(typical_size);
+            jitter.reserve(typical_size);
+            discards.reserve(typical_size);
+
+            side = uniform_int_distribution<i32>(0, 1)(rng) ? 1 : -1;
+        }
+
+        // non-copyable
+        hand(const hand& other) = delete;
+        hand& operator=(const hand& other) = delete;
+
+        // movable
+        hand(hand&& other) = default;
+        hand& operator=(hand&& other) = default;
+
+        // Hangs the arrangement under a parent, the pivot at the offset.
+        void attach(entity_id parent, vec3<> offset)
+        {
+            node.set_parent(parent);
+            node.get_transform().pos = offset;
+        }
+
+        // Places the cards at once.
         void arrange() 
         {
-            random_device dev;
-            mt19937 rng(dev());
-            uniform_real_distribution<f32> degress(0.0f, 2.5f);
+            for (usize i = 0; i < cards.size(); ++i) 
+            {
+                ts::transform t = slot(i);
+                card& c = (*stock)[cards[i]];
+                c.set_depth((u16)i);
+                c.get_transform().pos = t.pos;
+                c.get_transform().rot = t.rot;
+            }
+
+            request_redraw();
+        }
+
+        // Slides the cards to their places, the last one after the delay,
+        // turning to reveal when it leaves. Cards still waiting to be dealt
+        // keep their own delay, only where they land changes.
+        void arrange(tween_system& tweens, f32 delay, 
+            shared<texture> reveal = nullptr)
+        {
+            for (usize i = 0; i < cards.size(); ++i) 
+            {
+                card& c = (*stock)[cards[i]];
+                ts::transform& from = c.get_transform();
+                ts::transform to = slot(i);
+                entity_id id = c.get_id();
+                bool last = i + 1 == cards.size();
+                f32 wait = last ? delay : 0.0f;
+
+                c.set_depth((u16)i);
+                if (!last 
+                    && tweens.retarget(id, tween_channel::position, to.pos)
+                    && tweens.retarget(id, tween_channel::rotation, to.rot))
+                    continue;
+
+                tweens.cancel(id, tween_channel::position);
+                tweens.cancel(id, tween_channel::rotation);
+                tweens.add(id, tween_channel::position, from.pos, to.pos, 
+                    move_time, easing::cubic_out, wait, 
+                    last ? reveal : nullptr);
+                tweens.add(id, tween_channel::rotation, from.rot, to.rot, 
+                    move_time, easing::cubic_out, wait);
+            }
+        }
+
+        void add_card(tween_system& tweens, u8 num, card_suit suit, 
+            bool face_up = true, f32 delay = 0.0f) 
+        {
+            uniform_real_distribution<f32> degrees(0.0f, 2.5f);
             uniform_int_distribution<i32> x(0, 10);
             uniform_int_distribution<i32> y(0, 15);
-            uniform_int_distribution<i32> b(0, 1);
 
-            i32 side = b(rng) ? 1 : -1;
-                        
-            const vec3<> pivot = trans.pos;
+            pool_handle h = stock->deal(num, suit, face_up);
+            card& c = (*stock)[h];
+            c.set_parent(node.get_id());
+            c.get_transform().pos = 
+                node.get_registry().to_local(node.get_id(), shoe);
+
+            // the shoe is on the table, cards wait in it face down
+            shared<texture> face = nullptr;
+            if (face_up) {
+                face = stock->get_face(num, suit);
+                c.set_side(stock->get_face(0, card_suit::back));
+            }
+
+            cards.push_back(h);
+            jitter.push_back({ (f32)x(rng), (f32)y(rng), 
+                degrees(rng) * (f32)numbers::pi / 180.0f });
+
+            arrange(tweens, delay, move(face));
+        }
 
-            for (i32 i = 0; i < cards.size(); ++i) 
+        // Turns a card over, the dealer's hole card.
+        void flip(tween_system& tweens, usize index, f32 delay = 0.0f)
+        {
+            if (index >= cards.size())
+                return;
+
+            card& c = (*stock)[cards[index]];
+            c.flip(tweens, c.is_face_up() 
+                ? stock->get_face(0, card_suit::back) 
+                : stock->get_face(c.get_num(), c.get_suit()), delay);
+        }
+
+        // Sweeps the cards off to the pile, one after another.
+        void collect(tween_system& tweens, vec3<> pile, f32 delay = 0.0f)
+        {
+            pile = node.get_registry().to_local(node.get_id(), pile);
+
+            for (usize i = 0; i < cards.size(); ++i)
             {
+                card& c = (*stock)[cards[i]];
+                ts::transform& from = c.get_transform();
+                entity_id id = c.get_id();
+                f32 wait = delay + 0.05f * i;
 
-                auto& c = cards[i];
+                tweens.cancel(id, tween_channel::position);
+                tweens.cancel(id, tween_channel::rotation);
+                tweens.add(id, tween_channel::position, from.pos, pile, 
+                    move_time, easing::quad_in, wait);
+                tweens.add(id, tween_channel::rotation, from.rot, 
+                    vec3<>{ 0.0f, 0.0f, 0.0f }, 
+                    move_time, easing::quad_in, wait);
 
-                i32 offset = 50 - (5 * cards.size());
-                offset = max(offset, 30);
-                i32 stride = offset * i;
-                
-                c.trans.pos.x = pivot.x + stride + side * x(rng);
-                c.trans.pos.y = pivot.y + side * y(rng);
-                c.trans.rot.z = side * degress(rng) * (f32)numbers::pi/180.0f;
-            }                
+                discards.push_back(cards[i]);
+            }
+
+            cards.clear();
+            jitter.clear();
         }
 
-        void add_card(u8 num, card_suit suit) 
+        // Gives the collected cards that made it to the pile back to the 
+        // deck.
+        void update(const tween_system& tweens)
         {
-            cards.emplace_back(num, suit);
-            arrange();
+            for (usize i = 0; i < discards.size();)
+                if (!tweens.is_active((*stock)[discards[i]].get_id())) {
+                    stock->collect(discards[i]);
+                    discards[i] = discards.back();
+                    discards.pop_back();
+                }
+                else
+                    ++i;
+        }
+
+        // Hands every card back to the deck at once, mid-flight or not.
+        void clear(tween_system& tweens)
+        {
+            for (auto* list : { &cards, &discards })
+            {
+                for (pool_handle h : *list) {
+                    tweens.cancel((*stock)[h].get_id());
+                    stock->collect(h);
+                }
+
+                list->clear();
+            }
+
+            jitter.clear();
         }
 
         void remove_card(u8 num, card_suit suit) 
@@ -78,18 +240,13 @@ export namespace blackjack {
             return cards.size(); 
         }
 
-        i32 get_value() const 
-        {            
-            i32 value = 0;
-            for (auto& c : cards)
-                value += c.get_value();
-
-            // if hand is over 21, count ace as 1
-            for (auto& c : cards)
-                if (c.get_value() == 11 && value > 21)
-                    value -= 10;
+        i32 get_value() const {
+            return count(false);
+        }
 
-            return value;
+        // what the table sees, face down cards left out
+        i32 get_visible_value() const {
+            return count(true);
         }
 
         bool is_blackjack() const {
@@ -100,10 +257,25 @@ export namespace blackjack {
             return get_value() > 21;
         }
 
-        void render(renderer& renderer) override 
-        {
-            for (auto& c : cards)
-                c.render(renderer);
+    private:
+        i32 count(bool visible_only) const
+        {            
+            i32 value = 0;
+            for (pool_handle h : cards) {
+                const card& c = (*stock)[h];
+                if (!visible_only || c.is_face_up())
+                    value += c.get_value();
+            }
+
+            // if hand is over 21, count ace as 1
+            for (pool_handle h : cards) {
+                const card& c = (*stock)[h];
+                if ((!visible_only || c.is_face_up()) 
+                    && c.get_value() == 11 && value > 21)
+                    value -= 10;
+            }
+
+            return value;
         }
     };
 
@@ -19,9 +19,52 @@
 */
 
 import blackjack;
+import std.core;
+
+tornasol::window_backend parse_backend(std::string_view name)
+{
+    if (name == "osmesa") return tornasol::window_backend::osmesa;
+    if (name == "egl")    return tornasol::window_backend::egl;
+    return tornasol::window_backend::native;
+}
+
+tornasol::quality_preset parse_quality(std::string_view name)
+{
+    if (name == "low")    return tornasol::quality_preset::low;
+    if (name == "medium") return tornasol::quality_preset::medium;
+    return tornasol::quality_preset::high;
+}
 
 int main(int argc, char** argv) 
 {   
-    return blackjack::run_client2();   
+    if (argc >= 4 && std::string_view(argv[1]) == "cook")
+        return blackjack::run_cooker(argv[2], { argv + 3, argv + argc });
+
+    if (argc >= 4 && std::string_view(argv[1]) == "pack")
+        return blackjack::run_packer(argv[2], { argv + 3, argv + argc });
+
+    // blackjack bench [frames] [native|egl|osmesa] [quality] [tables]
+    // Offscreen backends still need a display, on a ci agent without one
+    // run under a virtual server: xvfb-run blackjack bench 1000 osmesa
+    if (argc >= 2 && std::string_view(argv[1]) == "bench")
+    {
+        return blackjack::run_benchmark(
+            argc >= 3 ? std::atoi(argv[2]) : 1000,
+            parse_backend(argc >= 4 ? argv[3] : ""),
+            parse_quality(argc >= 5 ? argv[4] : ""),
+            argc >= 6 ? std::atoi(argv[5]) : 1);
+    }
+
+    if (argc >= 2 && std::string_view(argv[1]) == "bench-entities")
+    {
+        return blackjack::run_entity_benchmark(
+            argc >= 3 ? std::atoi(argv[2]) : 10000,
+            argc >= 4 ? std::atoi(argv[3]) : 300,
+            parse_backend(argc >= 5 ? argv[4] : ""));
+    }
+
+    // blackjack [low|medium|high] [tables]
+    return blackjack::run_client2(parse_quality(argc >= 2 ? argv[1] : ""),
+        argc >= 3 ? std::atoi(argv[2]) : 1);
     //return bk::run_server();
 }
\ No newline at end of file
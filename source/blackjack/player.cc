@@ -22,8 +22,11 @@ export module blackjack:player;
 
 import :button;
 import :card;
+import :deck;
+import :def;
 import :hand;
 import :image;
+import :text;
 
 import std.core;
 import std.filesystem;
@@ -54,10 +57,16 @@ export namespace blackjack {
 		stand
 	};
 
-    class player : public entity {
+    class player {
     protected:
+        asset_manager& assets;
+        registry& reg;
+        tween_system& tweens;
         u8 num;
         bool curr;
+        vec3<> pos;
+        // the seat, everything below is placed relative to it
+        scoped_entity seat;
         // state
         player_state state;
         // images
@@ -66,6 +75,7 @@ export namespace blackjack {
         ui_image decor;
         ui_image busted;
         ui_image state_label;
+        ui_text total;
         // buttons
         ui_button hit_button;
         ui_button stand_button;
@@ -73,38 +83,84 @@ export namespace blackjack {
     public:
         hand hand;
 
-        player(u8 num, bool curr = false)
-            : num(num), curr(curr), state(player_state::idle)
+        player(asset_manager& assets, registry& reg, tween_system& tweens,
+            deck& cards, font& fnt, u8 num, bool curr = false)
+            : assets(assets), reg(reg), tweens(tweens), num(num), curr(curr), 
+              pos(0.0f, 0.0f, 0.0f), seat(reg, component_transform), 
+              state(player_state::idle),
+              label(reg, layer_table), 
+              placeholder(reg, layer_table), 
+              decor(reg, layer_overlay),
+              busted(reg, layer_overlay), 
+              state_label(reg, layer_table),
+              total(fnt, 20.0f),
+              hit_button(reg, layer_buttons), 
+              stand_button(reg, layer_buttons),
+              hand(reg, cards)
         {
             wstring label_str = L"player_" + to_wstring(num);
 
             if (curr) {
-                label.set_image(
+                label.set_image(assets, 
                     path(L"./content/player/player_you.png"));
 
                 hit_button.on_click = [this]() { hit(); };
                 stand_button.on_click = [this]() { stand(); };
             }                
             else {
-                label.set_image(
+                label.set_image(assets, 
                     path(L"./content/player/" + label_str + L".png"));
 
                 hit_button.enable = false;
                 stand_button.enable = false;
             }                
 
-            placeholder.set_image(
+            placeholder.set_image(assets, 
                 path(L"./content/player/placeholder.png"));
-            decor.set_image(
+            decor.set_image(assets, 
                 path(L"./content/player/decor.png"));
-            busted.set_image(
+            busted.set_image(assets, 
                 path(L"./content/player/busted.png"));
-            hit_button.set_image(
+            hit_button.set_image(assets, 
                 path(L"./content/player/hit.png"), 
                 path(L"./content/player/hit_hover.png"));
-            stand_button.set_image(
+            stand_button.set_image(assets, 
                 path(L"./content/player/stand.png"), 
-                path(L"./content/player/stand_hover.png"));            
+                path(L"./content/player/stand_hover.png"));
+
+            decor.set_visible(false);
+            busted.set_visible(false);
+            state_label.set_visible(false);
+
+            // fixed offsets within the seat, set once
+            entity_id s = seat.get_id();
+            label.set_parent(s);
+            placeholder.set_parent(s);
+            placeholder.set_pos({ 0.0f, 52.0f, 0.0f });
+            state_label.set_parent(s);
+            state_label.set_pos({ -5.0f, 312.0f, 0.0f });
+            hit_button.set_parent(s);
+            hit_button.set_pos({ -5.0f, 330.0f, 0.0f });
+            stand_button.set_parent(s);
+            stand_button.set_pos({ 91.0f, 330.0f, 0.0f });
+            busted.set_parent(s);
+            busted.set_pos({ -50.0f, 65.0f, 0.0f });
+            decor.set_parent(s);
+            decor.set_pos({ -55.0f, 100.0f, 0.0f });
+            hand.attach(s, { -15.0f, 52.0f, 0.0f });
+        }
+
+        vec3<> get_pos() const {
+            return pos;
+        }
+
+        // Moves the seat, its images, buttons and cards follow.
+        void set_pos(vec3<> p)
+        {
+            pos = p;
+            seat.get_transform().pos = p;
+            total.set_pos(p + vec3<>{-5.f, 284.f, 0.f});
+            request_redraw();
         }
 
         player_state get_state() const {
@@ -114,32 +170,35 @@ export namespace blackjack {
         void set_state(player_state state) 
         {            
             this->state = state;
+            request_redraw();
             hit_button.enable = state == player_state::play;
             stand_button.enable = state == player_state::play;
+            busted.set_visible(state == player_state::bust);
+            decor.set_visible(state == player_state::blackjack);
 
             switch (state) {
             case player_state::win:
-                state_label.set_image(path(L"./content/player/win.png"));
-                state_label.enable = true;
+                state_label.set_image(assets, path(L"./content/player/win.png"));
+                state_label.set_visible(true);
                 break;
             case player_state::lose:
-                state_label.set_image(path(L"./content/player/lose.png"));
-                state_label.enable = true;
+                state_label.set_image(assets, path(L"./content/player/lose.png"));
+                state_label.set_visible(true);
                 break;
             case player_state::push:
-                state_label.set_image(path(L"./content/player/tie.png"));
-                state_label.enable = true;
+                state_label.set_image(assets, path(L"./content/player/tie.png"));
+                state_label.set_visible(true);
                 break;
 		    case player_state::blackjack:
-			    state_label.set_image(path(L"./content/player/blackjack.png"));
-			    state_label.enable = true;
+			    state_label.set_image(assets, path(L"./content/player/blackjack.png"));
+			    state_label.set_visible(true);
 			    break;
 			case player_state::bust:
-				state_label.set_image(path(L"./content/player/bust.png"));
-				state_label.enable = true;
+				state_label.set_image(assets, path(L"./content/player/bust.png"));
+				state_label.set_visible(true);
 				break;
             default: 
-                state_label.enable = false;
+                state_label.set_visible(false);
             }
         }
 
@@ -147,10 +206,11 @@ export namespace blackjack {
             return hand;
         }
 
-        void add_card(u8 num, card_suit suit)
+        // Deals a card from the shoe, it lands after the delay.
+        void add_card(u8 num, card_suit suit, f32 delay = 0.0f, 
+            bool face_up = true)
         {
-            hand.trans.pos = trans.pos + vec3<>{ -15.f, 52.f, 0.0f};
-            hand.add_card(num, suit);
+            hand.add_card(tweens, num, suit, face_up, delay);
 
             if (hand.is_blackjack())
                 set_state(player_state::blackjack);
@@ -158,6 +218,24 @@ export namespace blackjack {
                 set_state(player_state::bust);
         }
 
+        void flip_card(usize index, f32 delay = 0.0f) {
+            hand.flip(tweens, index, delay);
+        }
+
+        // Gives the cards back to the pile and waits for the next round.
+        void collect(vec3<> pile, f32 delay = 0.0f)
+        {
+            hand.collect(tweens, pile, delay);
+            set_state(player_state::idle);
+        }
+
+        // Hands the cards back to the deck at once, for a fresh start.
+        void clear()
+        {
+            hand.clear(tweens);
+            set_state(player_state::idle);
+        }
+
         void hit() {
             // pass
             print("hit");
@@ -168,52 +246,19 @@ export namespace blackjack {
             print("stand");
         }
 
-        void update(const input & in) override
+        void update(const input & in)
         {
-            if (!enable)
-                return;
-
             hit_button.update(in);
             stand_button.update(in);
-        }
+            hand.update(tweens);
 
-        void render(renderer & renderer) override
-        {
-            if (!enable)
-                return;
-
-            vec3<> p = trans.pos;
-
-            label.trans.pos = p;    
-            label.render(renderer);
-            
-            placeholder.trans.pos = p + vec3<>{0.0f, 52.f, 0.0f};
-            placeholder.render(renderer);
-
-            state_label.trans.pos = p + vec3<>{-5.f, 312.f, 0.f};
-            state_label.render(renderer);
-            
-            hand.trans.pos = p + vec3<>{ -15.f, 52.f, 0.0f};
-            hand.render(renderer);
-            
-            hit_button.trans.pos = p + vec3<>{-5.f, 330.f, 0.0f};
-            hit_button.render(renderer);
-            
-            stand_button.trans.pos = p + vec3<>{91.f, 330.f, 0.0f};
-            stand_button.render(renderer);
-
-            if (state == player_state::bust)
-            {
-                busted.trans.pos = p + vec3<>{-50.f, 65.f, 0.f};
-                busted.render(renderer);
-            }
-            else if (state == player_state::blackjack) 
-            {
-                decor.trans.pos = p + vec3<>{-55.0f, 100.0f, 0.0f};
-                decor.render(renderer);
-            }               
+            total.set_visible(hand.get_size() > 0);
+            total.set_text(to_string(hand.get_visible_value()));
+        }
 
-            
+        // what the registry does not draw, placed by the table's view
+        void record(command_list& list, const mat4<>& view) const {
+            total.record(list, view);
         }
     };
 }
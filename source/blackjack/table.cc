@@ -0,0 +1,198 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module blackjack:table;
+
+import :card;
+import :dealer;
+import :deck;
+import :def;
+import :image;
+import :player;
+import :text;
+import std.core;
+import std.filesystem;
+import tornasol;
+
+using namespace std;
+using namespace std::filesystem;
+using namespace tornasol;
+
+export namespace blackjack {
+
+    // One table: its seats, dealer and cards in a registry of their own,
+    // laid out in table coordinates. A view transform places the table in
+    // the window, so several can share one. Textures come from the 
+    // client's asset manager, every table draws the same ones.
+    class table {
+    public:
+        static constexpr f32 width = 1280.0f;
+        static constexpr f32 height = 720.0f;
+
+    private:
+        // pause between two dealt cards, in seconds
+        static constexpr f32 deal_interval = 0.12f;
+
+        // every sprite on the table, outlives the objects that own them
+        registry entities;
+        tween_system tweens;
+        deck cards; // dealt round after round, never destroyed
+
+        // components
+        ui_image bg; // background
+        vector<player> players;
+        dealer dea;
+
+        // rng
+        random_device dev;
+        mt19937 rng;
+
+    public:
+        table(asset_manager& assets, font& fnt)
+            : cards(assets, entities), bg(entities, layer_background), 
+              dea(assets, entities, tweens, cards, fnt), rng(dev())
+        {
+            // setup table background
+            bg.set_image(assets, path(L"./content/game/background.png"));
+
+            // setup players
+            players.reserve(4);
+            players.emplace_back(assets, entities, tweens, cards, fnt, 1);
+            players.emplace_back(assets, entities, tweens, cards, fnt, 2);
+            players.emplace_back(assets, entities, tweens, cards, fnt, 3, 
+                true);
+            players.emplace_back(assets, entities, tweens, cards, fnt, 4);
+
+            for (i32 i = 0; i < 4; ++i)
+                players[i].set_pos(
+                    vec3<>{ 70, 325, 0 } + f32(i) * vec3<>{320, 0, 0});
+
+            // setup dealer
+            dea.set_pos({ 560.0f, -40.0f, 0.0f });
+
+            deal();
+        }
+
+        // non-copyable
+        table(const table&) = delete;
+        table& operator=(const table&) = delete;
+
+        vector<player>& get_players() {
+            return players;
+        }
+
+        const mat4<>& get_view() const {
+            return entities.get_view();
+        }
+
+        // table coordinates to the window's, scale and translation only
+        void set_view(const mat4<>& view) {
+            entities.set_view(view);
+        }
+
+        // true when the point, in window coordinates, is over the table
+        bool contains(vec2<> point) const
+        {
+            const mat4<>& v = entities.get_view();
+            return rect<>(v[3][0], v[3][1], width * v[0][0], height * v[1][1])
+                .contains(point);
+        }
+
+        // Deals two cards around the table, the dealer's second one face
+        // down, and turns it once everyone has theirs.
+        void deal(f32 delay = 0.0f)
+        {
+            uniform_int_distribution<u32> num_dist(1, 12);
+            uniform_int_distribution<u32> suit_dist(1, 4);
+
+            for (i32 round = 0; round < 2; ++round)
+            {
+                for (auto& p : players) {
+                    p.add_card(num_dist(rng), (card_suit)suit_dist(rng), 
+                        delay);
+                    delay += deal_interval;
+                }
+
+                dea.add_card(num_dist(rng), (card_suit)suit_dist(rng), 
+                    delay, round == 0);
+                delay += deal_interval;
+            }
+
+            dea.flip_card(1, delay + 4.0f * deal_interval);
+        }
+
+        // Sweeps every hand to the pile and deals again.
+        void next_round()
+        {
+            // inside the table, so cards don't cross neighbouring tables
+            const vec3<> pile = { 20.0f, 20.0f, 0.0f };
+            f32 delay = 0.0f;
+
+            for (auto& p : players) {
+                p.collect(pile, delay);
+                delay += deal_interval;
+            }
+
+            dea.collect(pile, delay);
+            deal(delay + 3.0f * deal_interval);
+        }
+
+        // Takes every card off the table at once and deals from scratch, 
+        // the cards and their textures are reused.
+        void reset()
+        {
+            for (auto& p : players)
+                p.clear();
+
+            dea.clear();
+            deal();
+        }
+
+        const deck& get_deck() const {
+            return cards;
+        }
+
+        // The keyboard only drives the focused table, the pointer picks
+        // against the hitboxes of every table.
+        void update(const input& in, f64 dt, bool focused)
+        {
+            if (focused && in.key_pressed(key::space))
+                next_round();
+
+            for (auto& p : players)
+                p.update(in);
+
+            dea.update(in);
+            tweens.update(entities, (f32)dt);
+            entities.update();
+        }
+
+        void record(command_list& frame) const
+        {
+            entities.record(frame);
+
+            const mat4<>& view = entities.get_view();
+            for (auto& p : players)
+                p.record(frame, view);
+
+            dea.record(frame, view);
+        }
+    };
+}
@@ -38,86 +38,76 @@ export namespace blackjack {
         pressed,    
     };
 
-    class ui_button : public entity {
+    class ui_button {
     private:
-        texture_renderer idle_tex;
-        texture_renderer hover_tex;
-        rect<> hitbox;
-        button_state state;
+        scoped_entity ent;
+        shared<texture> idle_tex;
+        shared<texture> hover_tex;
+
     public:
+        bool enable;
         function<void()> on_click;
         function<void()> on_hover;
 
-        ui_button() 
-            : state(button_state::idle) {}
+        ui_button(registry& reg, i32 layer = 0) 
+            : ent(reg, component_transform | component_sprite 
+                | component_hitbox | component_state, layer),
+              enable(true) {}
 
         button_state get_state() const { 
-            return state; 
+            return (button_state)ent.get_state(); 
         }
 
-        void set_image(path idle_path, path hover_path)
+        void set_image(asset_manager& assets, path idle_path, 
+            path hover_path)
         {
-            image idle_img = image(idle_path);
-            image hover_img = image(hover_path);
-
-            const f32 w = (f32)idle_img.width;
-            const f32 h = (f32)idle_img.height;
-
-            hitbox = { w, h };
+            idle_tex = assets.get_texture(idle_path);
+            hover_tex = assets.get_texture(hover_path);
+            ent.get_sprite().texture = idle_tex;
+        }
 
-            idle_tex.set_rect({ 0.0f, 0.0f, w, h });
-            idle_tex.set_image(idle_img);
+        void set_pos(vec3<> pos) {
+            ent.get_transform().pos = pos;
+        }
 
-            hover_tex.set_rect({ 0.0f, 0.0f, w, h });
-            hover_tex.set_image(hover_img);
+        // position becomes relative to the parent's
+        void set_parent(entity_id parent) {
+            ent.set_parent(parent);
         }
 
-        void update(const input& in) override 
+        void update(const input& in) 
         {
+            // disabled buttons are hidden, which also drops their hitbox
+            ent.get_sprite().visible = enable;
+
             if (!enable) 
                 return;
             
-            hitbox = { 
-                trans.pos.x, trans.pos.y, 
-                hitbox.w, hitbox.h 
-            };
-
-            if (in.mouse_pressed(mouse_button::left) 
-                && hitbox.contains(in.cursor_pos())) 
-            {        
+            button_state prev = get_state();
+            button_state state;
+            bool inside = ent.contains(in.cursor_pos());
+
+            if (inside && in.mouse_down(mouse_button::left))
                 state = button_state::pressed;
-            } 
-            else if (hitbox.contains(in.cursor_pos()))                
+            else if (inside)
                 state = button_state::hover;
             else
                 state = button_state::idle;
+
+            if (state != prev) 
+            {
+                ent.get_state() = (u32)state;
+                ent.get_sprite().texture = 
+                    state == button_state::idle ? idle_tex : hover_tex;
+                request_redraw();
+            }
             
-            if (on_click && state == button_state::pressed)
+            // fires once per press, not every frame the button is held
+            if (on_click && inside && in.mouse_pressed(mouse_button::left))
                 on_click();
 
             if (on_hover && state == button_state::hover)
                 on_hover();
         }
-
-        void render(renderer& r) override 
-        {
-            if (!enable) 
-                return;
-            
-            idle_tex.set_model(trans.get_mat());
-            hover_tex.set_model(trans.get_mat());
-
-            switch (state) {
-            case button_state::idle:
-                r.render(idle_tex);
-                break;
-            case button_state::hover:
-                r.render(hover_tex);
-                break;
-            case button_state::pressed:
-                r.render(hover_tex);
-                break;
-            }
-        }
     };
-}
\ No newline at end of file
+}
@@ -30,26 +30,37 @@ using namespace tornasol;
 
 export namespace blackjack {
 
-    class ui_image : public entity {
+    class ui_image {
     private:
-        texture_renderer tex;
+        scoped_entity ent;
+
     public:
-        ui_image() = default;
+        ui_image(registry& reg, i32 layer = 0)
+            : ent(reg, component_transform | component_sprite, layer) {}
+
+        void set_image(asset_manager& assets, path path) {
+            ent.get_sprite().texture = assets.get_texture(path);
+        }
+
+        ts::transform& get_transform() {
+            return ent.get_transform();
+        }
+
+        void set_pos(vec3<> pos) {
+            ent.get_transform().pos = pos;
+        }
 
-        void set_image(path path) 
-        {
-            image img = image(path);
-            tex.set_rect({ 0.0f, 0.0f, (f32)img.width, (f32)img.height });
-            tex.set_image(img);
+        // position becomes relative to the parent's
+        void set_parent(entity_id parent) {
+            ent.set_parent(parent);
         }
 
-        void render(renderer& renderer) override 
-        {
-            if (!enable)
-                return;
+        bool is_visible() const {
+            return ent.get_sprite().visible;
+        }
 
-            tex.set_model(trans.get_mat());
-            renderer.render(tex);
+        void set_visible(bool value) {
+            ent.get_sprite().visible = value;
         }
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,104 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module blackjack:text;
+import :def;
+
+import std.core;
+import tornasol;
+
+using namespace std;
+using namespace tornasol;
+
+export namespace blackjack {
+
+    // where the cooker stores the baked font atlas in the pack
+    const wchar_t font_path[] = L"./content/font/segments.sdf";
+
+    // The segment font, from the pack when it was cooked, baked on the 
+    // spot otherwise.
+    shared<texture> load_font_atlas(asset_manager& assets)
+    {
+        if (assets.is_cooked(font_path))
+            return assets.get_texture(font_path);
+
+        return assets.load_image(bake_segment_font());
+    }
+
+    // A line of dynamic text, totals and bets, drawn from the font atlas 
+    // instead of an image of its own.
+    class ui_text {
+    private:
+        font& fnt;
+        f32 size;
+        i32 layer;
+        string value;
+        shared<const shaped_text> shaped;
+        vec3<> pos;
+        color tint;
+        bool visible;
+
+    public:
+        ui_text(font& fnt, f32 size, i32 layer = layer_overlay)
+            : fnt(fnt), size(size), layer(layer), pos(0.0f, 0.0f, 0.0f), 
+              tint(0xffffffff), visible(true) {}
+
+        const string& get_text() const {
+            return value;
+        }
+
+        // shaping is cached by the font, setting the same text is free
+        void set_text(string_view text)
+        {
+            if (shaped && text == value)
+                return;
+
+            value = text;
+            shaped = fnt.shape(value, size);
+        }
+
+        void set_pos(vec3<> p) {
+            pos = p;
+        }
+
+        void set_color(color c) {
+            tint = c;
+        }
+
+        bool is_visible() const {
+            return visible;
+        }
+
+        void set_visible(bool value) {
+            visible = value;
+        }
+
+        void record(command_list& list, const mat4<>& view = mat4<>(1.0f)) const
+        {
+            if (!visible || !shaped || shaped->quads.empty())
+                return;
+
+            mat4<> model(1.0f);
+            translate(model, pos);
+            list.draw_text(0, layer, 0, fnt.get_atlas(), shaped, view * model, 
+                tint);
+        }
+    };
+}
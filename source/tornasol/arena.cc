@@ -0,0 +1,213 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module tornasol:arena;
+
+import :types;
+
+import <algorithm>;
+import <atomic>;
+import <cstddef>;
+import <memory>;
+import <memory_resource>;
+import <new>;
+import <utility>;
+import <vector>;
+
+namespace tornasol {
+
+    // totals over every frame arena
+    std::atomic<u64> arena_allocations = 0;
+    std::atomic<u64> arena_bytes = 0;
+    std::atomic<u64> arena_heap_allocations = 0;
+}
+
+export namespace tornasol {
+
+    // Bump allocator over a list of chunks. Nothing is freed on its own,
+    // reset() rewinds every chunk at once and keeps them for reuse, so a
+    // steady workload stops allocating after the first frames.
+    class linear_allocator {
+    private:
+        struct chunk {
+            unique<byte[]> data;
+            usize size;
+        };
+
+        std::vector<chunk> chunks;
+        usize chunk_size;
+        usize current; // chunk being filled
+        usize offset;  // within it
+        usize used;    // since the last reset, padding included
+
+    public:
+        linear_allocator(usize chunk_size = 64 * 1024)
+            : chunk_size(chunk_size), current(0), offset(0), used(0) {}
+
+        // non-copyable
+        linear_allocator(const linear_allocator&) = delete;
+        linear_allocator& operator=(const linear_allocator&) = delete;
+
+        // movable
+        linear_allocator(linear_allocator&&) = default;
+        linear_allocator& operator=(linear_allocator&&) = default;
+
+        void* allocate(usize size, usize align)
+        {
+            while (current < chunks.size())
+            {
+                chunk& c = chunks[current];
+                usize start = (offset + align - 1) & ~(align - 1);
+
+                if (start + size <= c.size) {
+                    used += start + size - offset;
+                    offset = start + size;
+                    return c.data.get() + start;
+                }
+
+                used += c.size - offset;
+                ++current;
+                offset = 0;
+            }
+
+            usize size_needed = std::max(chunk_size, size + align);
+            chunks.push_back({ std::make_unique<byte[]>(size_needed), 
+                size_needed });
+            current = chunks.size() - 1;
+            offset = 0;
+            return allocate(size, align);
+        }
+
+        template <typename T, typename... A>
+        T* create(A&&... args) {
+            return new (allocate(sizeof(T), alignof(T))) T(std::forward<A>(args)...);
+        }
+
+        void reset() 
+        {
+            current = 0;
+            offset = 0;
+            used = 0;
+        }
+
+        usize get_used() const {
+            return used;
+        }
+
+        usize get_capacity() const
+        {
+            usize total = 0;
+            for (auto& c : chunks)
+                total += c.size;
+            return total;
+        }
+
+        // chunks taken from the heap so far
+        usize get_chunk_count() const {
+            return chunks.size();
+        }
+    };
+
+    struct arena_stats {
+        u64 allocations;      // served by frame arenas, since startup
+        u64 bytes;            // requested from them
+        u64 heap_allocations; // chunks they had to take from the heap
+    };
+
+    // Memory for data that lives no longer than a frame: scratch arrays,
+    // lookup keys. Plugs into std::pmr containers, deallocation does 
+    // nothing and reset() takes everything back at once.
+    // Each thread has its own, see get_frame_arena().
+    class frame_arena : public std::pmr::memory_resource {
+    private:
+        linear_allocator memory;
+        usize peak; // most used between two resets
+
+    public:
+        frame_arena(usize chunk_size = 256 * 1024)
+            : memory(chunk_size), peak(0) {}
+
+        // non-copyable
+        frame_arena(const frame_arena&) = delete;
+        frame_arena& operator=(const frame_arena&) = delete;
+
+        // Everything allocated from the arena is gone, containers using it
+        // must be gone too.
+        void reset() 
+        {
+            peak = std::max(peak, memory.get_used());
+            memory.reset();
+        }
+
+        usize get_used() const {
+            return memory.get_used();
+        }
+
+        usize get_peak() const {
+            return std::max(peak, memory.get_used());
+        }
+
+        usize get_capacity() const {
+            return memory.get_capacity();
+        }
+
+    protected:
+        void* do_allocate(usize bytes, usize align) override
+        {
+            const usize chunks = memory.get_chunk_count();
+            void* p = memory.allocate(bytes, align);
+
+            arena_allocations.fetch_add(1, std::memory_order_relaxed);
+            arena_bytes.fetch_add(bytes, std::memory_order_relaxed);
+            if (memory.get_chunk_count() != chunks)
+                arena_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+
+            return p;
+        }
+
+        // freed by reset()
+        void do_deallocate(void*, usize, usize) override {}
+
+        bool do_is_equal(const std::pmr::memory_resource& other) 
+            const noexcept override 
+        {
+            return this == &other;
+        }
+    };
+
+    // The calling thread's frame arena. Only two threads reset theirs:
+    // the render thread in renderer::present and the logic thread after
+    // every tick. Anything else, network and loader threads, the cooker,
+    // must not use it, their arena would only grow.
+    frame_arena& get_frame_arena()
+    {
+        thread_local frame_arena arena;
+        return arena;
+    }
+
+    arena_stats get_arena_stats()
+    {
+        return {
+            arena_allocations.load(std::memory_order_relaxed),
+            arena_bytes.load(std::memory_order_relaxed),
+            arena_heap_allocations.load(std::memory_order_relaxed)
+        };
+    }
+}
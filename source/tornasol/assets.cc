@@ -0,0 +1,292 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module tornasol:assets;
+
+import :image;
+import :loader;
+import :pack;
+import :texture;
+import :types;
+
+import <chrono>;
+import <deque>;
+import <filesystem>;
+import <limits>;
+import <memory>;
+import <mutex>;
+import <span>;
+import <string>;
+import <unordered_map>;
+import <vector>;
+
+export namespace tornasol {
+
+    using asset_id = u32;
+
+    // Interns asset paths to ids and shares one texture per path between
+    // every user. Textures are streamed through a texture_loader and, when
+    // the estimated video memory goes over budget, the least recently used
+    // ones that nobody else holds are released. They are reloaded on demand.
+    //
+    // Assets found in a mounted asset_pack are read from the mapped file
+    // instead of being opened one by one: cooked textures skip decoding and 
+    // are uploaded on the next update, raw images are decoded from memory.
+    //
+    // Textures can be requested from any thread, update() must run on the 
+    // one owning the gl context.
+    class asset_manager {
+    private:
+        struct entry {
+            fs::path path;
+            std::string key;
+            shared<texture> tex;
+            u64 last_use;
+        };
+
+        struct cooked_upload {
+            shared<texture> tex;
+            const pack_entry* cooked;
+        };
+
+        // the pack outlives the loader, its workers may be decoding from it
+        unique<asset_pack> pack;
+        texture_loader loader;
+        std::unordered_map<std::string, asset_id> ids;
+        std::vector<entry> entries;
+        std::deque<cooked_upload> uploads;
+        usize budget;
+        u64 tick;
+        mutable std::mutex mutex;
+
+    public:
+        static constexpr usize default_budget = 256 * 1024 * 1024;
+
+        asset_manager(usize budget = default_budget)
+            : budget(budget), tick(0) {}
+
+        // mounts the pack right away, see mount()
+        asset_manager(const fs::path& pack, usize budget = default_budget)
+            : asset_manager(budget)
+        {
+            mount(pack);
+        }
+
+        // non-copyable
+        asset_manager(const asset_manager&) = delete;
+        asset_manager& operator=(const asset_manager&) = delete;
+
+        asset_id intern(const fs::path& path)
+        {
+            std::scoped_lock lock(mutex);
+            return find_or_add(path);
+        }
+
+        shared<texture> get_texture(asset_id id)
+        {
+            std::scoped_lock lock(mutex);
+            return acquire(id);
+        }
+
+        shared<texture> get_texture(const fs::path& path) 
+        {
+            std::scoped_lock lock(mutex);
+            return acquire(find_or_add(path));
+        }
+
+        // Uploads pending textures and enforces the memory budget. Must be
+        // called once per frame from the thread owning the gl context.
+        void update(f64 upload_budget)
+        {
+            std::scoped_lock lock(mutex);
+
+            // cooked textures are a plain copy, so they go first and at 
+            // least one per frame
+            auto start = std::chrono::steady_clock::now();
+            auto budget_end = start + std::chrono::duration<f64>(upload_budget);
+
+            while (!uploads.empty())
+            {
+                upload(uploads.front());
+                uploads.pop_front();
+
+                if (std::chrono::steady_clock::now() >= budget_end)
+                    break;
+            }
+
+            f64 left = std::chrono::duration<f64>(
+                budget_end - std::chrono::steady_clock::now()).count();
+            loader.update(left > 0.0 ? left : 0.0);
+
+            while (get_memory_unlocked() > budget && evict_one()) {}
+        }
+
+        // Serves assets from a pack from now on. Returns false if the pack
+        // does not exist, assets keep streaming from their own files. Must be
+        // called before anything is loaded.
+        bool mount(const fs::path& path)
+        {
+            if (!fs::exists(path))
+                return false;
+
+            std::scoped_lock lock(mutex);
+            pack = std::make_unique<asset_pack>(path);
+            return true;
+        }
+
+        // true when the mounted pack holds the asset cooked
+        bool is_cooked(const fs::path& path) const
+        {
+            std::scoped_lock lock(mutex);
+            const pack_entry* e = pack ? pack->find(pack_key(path)) : nullptr;
+            return e && e->kind == pack_kind::texture;
+        }
+
+        // Streams pixels generated at runtime into a texture of their own,
+        // outside the cache and its budget.
+        shared<texture> load_image(image pixels)
+        {
+            std::scoped_lock lock(mutex);
+            return loader.load(std::move(pixels));
+        }
+
+        // Decodes an image synchronously, from the pack if it holds the file
+        // raw. For the few assets needed before anything can stream.
+        image read_image(const fs::path& path)
+        {
+            std::span<const byte> bytes = 
+                pack ? pack->get(pack_key(path)) : std::span<const byte>();
+
+            return bytes.empty() ? image(path) : image(bytes);
+        }
+
+        bool is_busy() const 
+        {
+            std::scoped_lock lock(mutex);
+            return !uploads.empty() || loader.is_busy();
+        }
+
+        usize get_budget() const {
+            return budget;
+        }
+
+        void set_budget(usize bytes) {
+            budget = bytes;
+        }
+
+        usize get_memory() const
+        {
+            std::scoped_lock lock(mutex);
+            return get_memory_unlocked();
+        }
+
+    private:
+        asset_id find_or_add(const fs::path& path)
+        {
+            std::string key = pack_key(path);
+            auto it = ids.find(key);
+
+            if (it != ids.end())
+                return it->second;
+
+            asset_id id = (asset_id)entries.size();
+            entries.push_back({ path, key, nullptr, 0 });
+            ids.emplace(std::move(key), id);
+            return id;
+        }
+
+        shared<texture> acquire(asset_id id)
+        {
+            entry& e = entries.at(id);
+
+            if (!e.tex)
+                e.tex = load(e);
+
+            e.last_use = ++tick;
+            return e.tex;
+        }
+
+        usize get_memory_unlocked() const
+        {
+            usize total = 0;
+            for (auto& e : entries)
+                if (e.tex)
+                    total += e.tex->get_memory();
+            return total;
+        }
+
+        shared<texture> load(const entry& e)
+        {
+            const pack_entry* cooked = pack ? pack->find(e.key) : nullptr;
+
+            if (!cooked)
+                return loader.load(e.path);
+
+            if (cooked->kind == pack_kind::raw)
+                return loader.load(pack->get_data(*cooked));
+
+            auto tex = std::make_shared<texture>();
+            uploads.push_back({ tex, cooked });
+            return tex;
+        }
+
+        void upload(const cooked_upload& item)
+        {
+            const pack_entry* cooked = item.cooked;
+            texture& tex = *item.tex;
+
+            tex.bind();
+            tex.set_wrap(texture_wrap::repeat, texture_wrap::repeat);
+            tex.set_filter(texture_filter::linear_mipmap_linear, 
+                texture_filter::linear);
+            tex.load_levels(
+                pack->get_data(*cooked).data(),
+                { (i32)cooked->width, (i32)cooked->height },
+                cooked->levels,
+                cooked->flags & pack_premultiplied);
+            tex.set_opaque(cooked->flags & pack_opaque);
+        }
+
+        // Releases the least recently used texture that is only referenced 
+        // by the cache. Returns false when there is nothing left to evict.
+        bool evict_one()
+        {
+            entry* lru = nullptr;
+            u64 oldest = std::numeric_limits<u64>::max();
+
+            for (auto& e : entries)
+            {
+                if (!e.tex || e.tex.use_count() > 1 || !e.tex->is_ready())
+                    continue;
+
+                if (e.last_use < oldest) {
+                    oldest = e.last_use;
+                    lru = &e;
+                }
+            }
+
+            if (!lru)
+                return false;
+
+            lru->tex.reset();
+            return true;
+        }
+    };
+}
@@ -22,12 +22,17 @@ export module tornasol:buffer;
 import :types;
 import :gl;
 
+import <cstring>;
+import <stdexcept>;
+import <vector>;
+
 export namespace tornasol {
     
     enum class buffer_type 
     {
-        vertex = gl::array_buffer,
-        index  = gl::element_buffer,
+        vertex       = gl::array_buffer,
+        index        = gl::element_buffer,
+        pixel_unpack = gl::pixel_unpack_buffer,
     };
 
     enum class buffer_usage 
@@ -95,6 +100,227 @@ export namespace tornasol {
         }
     };
 
+    class pixel_buffer {
+    private:
+        u32 id;
+        u32 size;
+
+    public:
+        pixel_buffer()
+            : id(gl::gen_buffer()), size(0) {}
+
+        ~pixel_buffer() {
+            gl::delete_buffer(id);
+        }
+
+        // non-copyable
+        pixel_buffer(const pixel_buffer&) = delete;
+        pixel_buffer& operator=(const pixel_buffer&) = delete;
+
+        // movable
+        pixel_buffer(pixel_buffer&& other)
+            : id(other.id), size(other.size)
+        {
+            other.id = 0;
+        }
+
+        pixel_buffer& operator=(pixel_buffer&& other)
+        {
+            id = other.id;
+            size = other.size;
+            other.id = 0;
+            return *this;
+        }
+
+        u32 get_id() const {
+            return id;
+        }
+
+        u32 get_size() const {
+            return size;
+        }
+
+        void bind() {
+            gl::bind_buffer(gl::pixel_unpack_buffer, id);
+        }
+
+        void unbind() {
+            gl::bind_buffer(gl::pixel_unpack_buffer, 0);
+        }
+
+        // Copies the pixels into the buffer so that a following texture 
+        // upload sources them from gpu memory instead of client memory.
+        // The storage is orphaned first so the driver never waits for a
+        // previous upload still reading from it.
+        void load(const void* data, u32 size)
+        {
+            gl::buffer_data(gl::pixel_unpack_buffer, size, nullptr, 
+                gl::stream_draw);
+
+            void* dst = gl::map_buffer(gl::pixel_unpack_buffer, 
+                gl::write_only);
+
+            if (dst == nullptr)
+                throw std::runtime_error("failed to map pixel buffer");
+
+            std::memcpy(dst, data, size);
+            gl::unmap_buffer(gl::pixel_unpack_buffer);
+            this->size = size;
+        }
+    };
+
+    // Ring buffer for data rewritten every frame, split in regions that
+    // are filled one after another. A region is fenced when it is left 
+    // and waited on before it is written again, so writes never stall on
+    // draws still reading and the driver has nothing to synchronize.
+    //
+    // With buffer storage the whole ring stays mapped, persistent and 
+    // coherent. Otherwise each write maps its range unsynchronized, the
+    // fences keep that safe.
+    class stream_buffer {
+    private:
+        u32 id;
+        buffer_type type;
+        u32 region_size;
+        u32 region;  // being written
+        u32 offset;  // within it
+        bool waited; // region fence already waited on
+        byte* mapped;
+        std::vector<gl::sync> fences;
+
+    public:
+        stream_buffer(buffer_type type, u32 region_size, u32 regions = 3)
+            : id(gl::gen_buffer()), type(type), region_size(region_size), 
+              region(0), offset(0), waited(true), mapped(nullptr), 
+              fences(regions, nullptr)
+        {
+            const isize size = (isize)region_size * regions;
+            bind();
+
+            if (gl::has_buffer_storage())
+            {
+                const u32 flags = gl::map_write_bit | gl::map_persistent_bit 
+                    | gl::map_coherent_bit;
+
+                gl::buffer_storage((gl::def)type, size, nullptr, flags);
+                mapped = (byte*)gl::map_buffer_range((gl::def)type, 0, size, 
+                    flags);
+
+                if (mapped == nullptr)
+                    throw std::runtime_error("failed to map stream buffer");
+            }
+            else
+                gl::buffer_data((gl::def)type, (i32)size, nullptr, 
+                    gl::stream_draw);
+        }
+
+        ~stream_buffer()
+        {
+            for (gl::sync f : fences)
+                if (f)
+                    gl::delete_sync(f);
+
+            // deleting the buffer unmaps it
+            gl::delete_buffer(id);
+        }
+
+        // non-copyable
+        stream_buffer(const stream_buffer&) = delete;
+        stream_buffer& operator=(const stream_buffer&) = delete;
+
+        u32 get_id() const {
+            return id;
+        }
+
+        bool is_persistent() const {
+            return mapped != nullptr;
+        }
+
+        void bind() {
+            gl::bind_buffer((gl::def)type, id);
+        }
+
+        // Copies data into the ring, returns its offset in the buffer.
+        u32 write(const void* data, u32 size, u32 align = 16)
+        {
+            if (size > region_size)
+                throw std::runtime_error("stream buffer region too small");
+
+            u32 start = (offset + align - 1) / align * align;
+
+            if (start + size > region_size) {
+                next_region();
+                start = 0;
+            }
+
+            if (!waited)
+                wait(fences[region]);
+
+            const u32 at = region * region_size + start;
+
+            if (mapped)
+                std::memcpy(mapped + at, data, size);
+            else
+            {
+                bind();
+                void* dst = gl::map_buffer_range((gl::def)type, at, size, 
+                    gl::map_write_bit | gl::map_invalidate_range 
+                    | gl::map_unsynchronized);
+
+                if (dst == nullptr)
+                    throw std::runtime_error("failed to map stream buffer");
+
+                std::memcpy(dst, data, size);
+                gl::unmap_buffer((gl::def)type);
+            }
+
+            offset = start + size;
+            return at;
+        }
+
+        // Fences what the frame wrote, the next frame starts a new region.
+        void end_frame() 
+        {
+            if (offset > 0)
+                next_region();
+        }
+
+    private:
+        void next_region()
+        {
+            fences[region] = gl::fence_sync();
+            region = (region + 1) % (u32)fences.size();
+            offset = 0;
+            waited = false;
+        }
+
+        void wait(gl::sync& fence)
+        {
+            waited = true;
+
+            if (!fence)
+                return;
+
+            // a second at a time, only a lost device takes that long
+            const u64 timeout = 1'000'000'000;
+
+            for (;;)
+            {
+                gl::def r = gl::client_wait_sync(fence, 
+                    gl::sync_flush_commands, timeout);
+
+                if (r == gl::already_signaled || r == gl::condition_satisfied)
+                    break;
+
+                if (r == gl::wait_failed)
+                    throw std::runtime_error("failed to wait for stream buffer");
+            }
+
+            gl::delete_sync(fence);
+            fence = nullptr;
+        }
+    };
+
     class vertex_array {
     private:
         u32 id;
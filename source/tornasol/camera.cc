@@ -0,0 +1,106 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module tornasol:camera;
+
+import :matrix;
+import :rect;
+import :size;
+import :transform;
+import :types;
+import :vector;
+
+import <algorithm>;
+import <cmath>;
+
+export namespace tornasol {
+
+    // Maps a fixed design resolution, the one everything is laid out in, 
+    // onto the framebuffer. The design keeps its aspect ratio and is 
+    // centered, bars fill the rest. Only resize() does any work, the 
+    // projection is read as is by every draw.
+    class camera {
+    public:
+        static constexpr size2<i32> default_design = { 1280, 720 };
+
+    private:
+        size2<i32> design;
+        size2<i32> framebuffer;
+        rect<i32> viewport; // letterboxed, framebuffer pixels
+        f32 scale;          // framebuffer pixels per design unit
+        mat4<> proj;
+
+    public:
+        camera(size2<i32> design = default_design)
+            : design(design), framebuffer({ 0, 0 }), viewport(0, 0, 0, 0),
+              scale(1.0f), 
+              proj(ortho(0.0f, (f32)design.w, (f32)design.h, 0.0f, 
+                  -1.0f, 1.0f))
+        {
+            resize(design);
+        }
+
+        void resize(size2<i32> size)
+        {
+            framebuffer = size;
+            if (size.w <= 0 || size.h <= 0)
+                return; // minimized, keep the last viewport
+
+            scale = std::min((f32)size.w / (f32)design.w, 
+                (f32)size.h / (f32)design.h);
+
+            i32 w = std::max((i32)std::lround(design.w * scale), 1);
+            i32 h = std::max((i32)std::lround(design.h * scale), 1);
+            viewport = { (size.w - w) / 2, (size.h - h) / 2, w, h };
+        }
+
+        size2<i32> get_design() const {
+            return design;
+        }
+
+        size2<i32> get_framebuffer() const {
+            return framebuffer;
+        }
+
+        // gl orientation, bottom-left origin
+        const rect<i32>& get_viewport() const {
+            return viewport;
+        }
+
+        f32 get_scale() const {
+            return scale;
+        }
+
+        // design coordinates to clip space, the same for every target
+        const mat4<>& get_proj() const {
+            return proj;
+        }
+
+        // design coordinates of a point in framebuffer pixels, top-left 
+        // origin
+        vec2<> to_design(vec2<> pixel) const
+        {
+            return { 
+                (pixel.x - (f32)viewport.x) / scale, 
+                (pixel.y - (f32)viewport.y) / scale 
+            };
+        }
+    };
+}
@@ -0,0 +1,423 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module tornasol:command;
+
+import :arena;
+import :color;
+import :font;
+import :framebuffer;
+import :matrix;
+import :rect;
+import :renderer;
+import :texture;
+import :types;
+
+import <algorithm>;
+import <memory>;
+import <new>;
+import <span>;
+import <utility>;
+import <vector>;
+
+export namespace tornasol {
+
+    enum class command_type : u8
+    {
+        bind_target,
+        set_scissor,
+        clear_scissor,
+        draw_sprite,
+        draw_text
+    };
+
+    // Sort key, most significant first:
+    //
+    //   | target 8 | layer 16 | depth 16 | stage 2 | unused 22 |
+    //
+    // Target switches are the most expensive, so they sort first. Within a
+    // layer, depth keeps overlapping sprites in painter's order. The stage
+    // puts state changes before the draws they apply to. Equal keys keep 
+    // the order they were recorded in, see command_queue; draws that may 
+    // overlap are never reordered by texture.
+    struct command_key {
+        static constexpr u64 stage_target  = 0;
+        static constexpr u64 stage_scissor = 1;
+        static constexpr u64 stage_draw    = 2;
+
+        static u8 get_target(u64 key) {
+            return (u8)(key >> 56);
+        }
+
+        static i32 get_layer(u64 key) {
+            return (i32)((key >> 40) & 0xffff) - 0x8000;
+        }
+
+        static u64 make(u8 target, i32 layer, u16 depth, u64 stage)
+        {
+            u64 l = (u64)(u16)(layer + 0x8000); // signed layers sort right
+
+            return ((u64)target << 56) | (l << 40) | ((u64)depth << 24)
+                | (stage << 22);
+        }
+    };
+
+    struct draw_sprite_command {
+        shared<texture> tex;
+        rect<> area;
+        mat4<> model;
+    };
+
+    struct draw_text_command {
+        shared<texture> atlas;
+        shared<const shaped_text> text;
+        mat4<> model;
+        color tint;
+    };
+
+    struct set_scissor_command {
+        rect<> area;
+    };
+
+    struct bind_target_command {
+        framebuffer* target;
+    };
+
+    // Commands recorded by one thread, with their payloads in the list's 
+    // own linear allocator. Lists are submitted on the gl thread through a
+    // command_queue, which sorts them by key.
+    class command_list {
+    public:
+        struct entry {
+            u64 key;
+            u64 hash; // of the command and its payload
+            u32 seq;  // recording order, breaks key ties
+            command_type type;
+            void* data;
+        };
+
+        static constexpr u64 empty_hash = 0xcbf29ce484222325ull;
+
+    private:
+        linear_allocator memory;
+        std::vector<entry> entries;
+        u64 hash;
+
+    public:
+        command_list()
+            : hash(empty_hash) {}
+
+        ~command_list() {
+            reset();
+        }
+
+        // non-copyable
+        command_list(const command_list&) = delete;
+        command_list& operator=(const command_list&) = delete;
+
+        // Drops every command, keeps the memory for the next recording.
+        void reset()
+        {
+            for (entry& e : entries)
+                if (e.type == command_type::draw_sprite)
+                    ((draw_sprite_command*)e.data)->~draw_sprite_command();
+                else if (e.type == command_type::draw_text)
+                    ((draw_text_command*)e.data)->~draw_text_command();
+
+            entries.clear();
+            memory.reset();
+            hash = empty_hash;
+        }
+
+        // Everything recorded afterwards with the same target slot goes
+        // into target, nullptr being the window.
+        void bind_target(u8 slot, framebuffer* target)
+        {
+            push(command_key::make(slot, -0x8000, 0, 
+                command_key::stage_target),
+                command_type::bind_target,
+                memory.create<bind_target_command>(target), 
+                mix(empty_hash, target));
+        }
+
+        // Clips the draws of one layer.
+        void set_scissor(u8 slot, i32 layer, const rect<>& area)
+        {
+            push(command_key::make(slot, layer, 0, 
+                command_key::stage_scissor),
+                command_type::set_scissor,
+                memory.create<set_scissor_command>(area), 
+                mix(empty_hash, area));
+        }
+
+        void clear_scissor(u8 slot, i32 layer)
+        {
+            push(command_key::make(slot, layer, 0, 
+                command_key::stage_scissor),
+                command_type::clear_scissor, nullptr, empty_hash);
+        }
+
+        void draw_sprite(u8 slot, i32 layer, u16 depth, 
+            shared<texture> tex, const rect<>& area, const mat4<>& model)
+        {
+            u64 key = command_key::make(slot, layer, depth, 
+                command_key::stage_draw);
+
+            u64 h = mix(mix(mix(empty_hash, tex.get()), area), model);
+            push(key, command_type::draw_sprite, 
+                memory.create<draw_sprite_command>(std::move(tex), area, model),
+                h);
+        }
+
+        // Shaped text, a single command however long.
+        void draw_text(u8 slot, i32 layer, u16 depth, shared<texture> atlas,
+            shared<const shaped_text> text, const mat4<>& model, 
+            const color& tint)
+        {
+            u64 key = command_key::make(slot, layer, depth, 
+                command_key::stage_draw);
+
+            u64 h = mix(mix(mix(empty_hash, atlas.get()), model), tint);
+            for (const glyph_quad& q : text->quads)
+                h = mix(mix(h, q.area), q.uv);
+            push(key, command_type::draw_text, 
+                memory.create<draw_text_command>(std::move(atlas), 
+                    std::move(text), model, tint), 
+                h);
+        }
+
+        const std::vector<entry>& get_entries() const {
+            return entries;
+        }
+
+        usize get_size() const {
+            return entries.size();
+        }
+
+        bool empty() const {
+            return entries.empty();
+        }
+
+        // Hash of every command and payload in recording order, equal 
+        // hashes mean the same frame.
+        u64 get_hash() const {
+            return hash;
+        }
+
+        // fnv-1a, folds a value into a hash
+        template <typename T>
+        static u64 mix(u64 hash, const T& value)
+        {
+            const byte* p = (const byte*)&value;
+            for (usize i = 0; i < sizeof(T); ++i)
+                hash = (hash ^ (u64)p[i]) * 0x100000001b3ull;
+            return hash;
+        }
+
+    private:
+        void push(u64 key, command_type type, void* data, u64 h) 
+        {
+            h = mix(mix(h, key), type);
+            entries.push_back({ key, h, (u32)entries.size(), type, data });
+            hash = mix(hash, h);
+        }
+    };
+
+    // Merges command lists, sorts them by key and executes them on the
+    // thread owning the gl context.
+    //
+    // Each target is drawn in two passes. Sprites with an opaque texture 
+    // go first, front to back with depth testing and no blending, so the 
+    // pixels they hide are never shaded. The rest follows in key order,
+    // blended and tested against them. Every draw gets a depth from its 
+    // position in key order, which keeps the painter's order intact.
+    class command_queue {
+    private:
+        struct item {
+            u64 key;
+            u32 list;
+            u32 seq;
+            const command_list::entry* cmd;
+            f32 depth;
+            bool opaque;
+        };
+
+        std::vector<item> items; // kept between submits
+
+    public:
+        command_queue() = default;
+
+        // non-copyable
+        command_queue(const command_queue&) = delete;
+        command_queue& operator=(const command_queue&) = delete;
+
+        void submit(renderer& renderer, const command_list& list) 
+        {
+            const command_list* lists[] = { &list };
+            submit(renderer, lists);
+        }
+
+        void submit(renderer& renderer, 
+            std::span<const command_list* const> lists)
+        {
+            submit(renderer, lists, [](const command_list::entry&) { 
+                return true; 
+            });
+        }
+
+        // Submits only the commands the filter accepts.
+        template <typename F>
+        void submit(renderer& renderer, 
+            std::span<const command_list* const> lists, F&& filter)
+        {
+            items.clear();
+            for (u32 l = 0; l < (u32)lists.size(); ++l)
+                for (auto& e : lists[l]->get_entries())
+                    if (filter(e))
+                        items.push_back({ e.key, l, e.seq, &e, 0.0f, false });
+
+            // ties keep the order of the lists, then of recording
+            std::sort(items.begin(), items.end(), 
+                [](const item& a, const item& b) {
+                    if (a.key != b.key) return a.key < b.key;
+                    if (a.list != b.list) return a.list < b.list;
+                    return a.seq < b.seq;
+                });
+
+            classify();
+
+            for (usize begin = 0; begin < items.size();)
+            {
+                const u8 target = command_key::get_target(items[begin].key);
+
+                usize end = begin;
+                while (end < items.size() 
+                    && command_key::get_target(items[end].key) == target)
+                    ++end;
+
+                submit_target(renderer, begin, end);
+                begin = end;
+            }
+
+            renderer.clear_scissor();
+            renderer.bind_target(nullptr);
+        }
+
+    private:
+        // Spreads depths over (-1, 1) in key order and picks the draws of
+        // the opaque pass. Layers with a scissor stay out of it, the pass
+        // runs unclipped.
+        void classify()
+        {
+            const f32 step = 2.0f / (f32)(items.size() + 1);
+
+            u64 layer = ~0ull;
+            bool clipped = false;
+            for (usize n = 0; n < items.size(); ++n)
+            {
+                item& i = items[n];
+                i.depth = -1.0f + step * (f32)(n + 1);
+
+                if ((i.key >> 40) != layer) {
+                    layer = i.key >> 40;
+                    clipped = false;
+                }
+
+                if (i.cmd->type == command_type::set_scissor)
+                    clipped = true;
+
+                i.opaque = !clipped 
+                    && i.cmd->type == command_type::draw_sprite
+                    && ((draw_sprite_command*)i.cmd->data)->tex->is_opaque();
+            }
+        }
+
+        void submit_target(renderer& renderer, usize begin, usize end)
+        {
+            // binds sort first in their target
+            while (begin < end 
+                && items[begin].cmd->type == command_type::bind_target)
+                execute(renderer, *items[begin++].cmd);
+
+            bool any_opaque = false;
+            for (usize n = begin; n < end && !any_opaque; ++n)
+                any_opaque = items[n].opaque;
+
+            if (any_opaque)
+            {
+                renderer.begin_opaque();
+                for (usize n = end; n-- > begin;)
+                    if (items[n].opaque) {
+                        renderer.set_depth(items[n].depth);
+                        execute(renderer, *items[n].cmd);
+                    }
+
+                renderer.begin_translucent();
+            }
+
+            // a scissor lasts until the end of its layer
+            u64 layer = ~0ull;
+            for (usize n = begin; n < end; ++n)
+            {
+                const item& i = items[n];
+                if ((i.key >> 40) != layer) {
+                    layer = i.key >> 40;
+                    renderer.clear_scissor();
+                }
+
+                if (i.opaque)
+                    continue;
+
+                renderer.set_depth(i.depth);
+                execute(renderer, *i.cmd);
+            }
+
+            if (any_opaque)
+                renderer.end_depth();
+        }
+
+        static void execute(renderer& renderer, 
+            const command_list::entry& e)
+        {
+            switch (e.type) {
+            case command_type::bind_target:
+                renderer.bind_target(((bind_target_command*)e.data)->target);
+                break;
+            case command_type::set_scissor:
+                renderer.set_scissor(((set_scissor_command*)e.data)->area);
+                break;
+            case command_type::clear_scissor:
+                renderer.clear_scissor();
+                break;
+            case command_type::draw_sprite: {
+                auto* cmd = (draw_sprite_command*)e.data;
+                renderer.render(*cmd->tex, cmd->area, cmd->model);
+                break;
+            }
+            case command_type::draw_text: {
+                auto* cmd = (draw_text_command*)e.data;
+                renderer.render(*cmd->atlas, *cmd->text, cmd->model, 
+                    cmd->tint);
+                break;
+            }
+            }
+        }
+    };
+}
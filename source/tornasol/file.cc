@@ -0,0 +1,130 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+module;
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+export module tornasol:file;
+import :types;
+
+import <filesystem>;
+import <span>;
+import <stdexcept>;
+
+export namespace tornasol {
+
+    // Read-only view of a whole file mapped into memory. Pages are brought
+    // in by the os on first touch, nothing is copied up front.
+    class mapped_file {
+    private:
+        const byte* data;
+        usize size;
+#ifdef _WIN32
+        HANDLE file;
+        HANDLE mapping;
+#else
+        int fd;
+#endif
+
+    public:
+        mapped_file(const fs::path& path)
+            : data(nullptr), size(0)
+        {
+#ifdef _WIN32
+            file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+            if (file == INVALID_HANDLE_VALUE)
+                throw std::runtime_error("failed to open file");
+
+            LARGE_INTEGER len;
+            GetFileSizeEx(file, &len);
+            size = (usize)len.QuadPart;
+
+            mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 
+                0, 0, nullptr);
+
+            if (mapping == nullptr) {
+                CloseHandle(file);
+                throw std::runtime_error("failed to map file");
+            }
+
+            data = (const byte*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+            fd = ::open(path.c_str(), O_RDONLY);
+
+            if (fd < 0)
+                throw std::runtime_error("failed to open file");
+
+            struct stat st;
+            fstat(fd, &st);
+            size = (usize)st.st_size;
+
+            void* ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            data = ptr == MAP_FAILED ? nullptr : (const byte*)ptr;
+#endif
+            if (data == nullptr) {
+                close();
+                throw std::runtime_error("failed to map file");
+            }
+        }
+
+        ~mapped_file() {
+            close();
+        }
+
+        // non-copyable
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        std::span<const byte> get_bytes() const {
+            return { data, size };
+        }
+
+        usize get_size() const {
+            return size;
+        }
+
+    private:
+        void close()
+        {
+#ifdef _WIN32
+            if (data) 
+                UnmapViewOfFile(data);
+            CloseHandle(mapping);
+            CloseHandle(file);
+#else
+            if (data) 
+                munmap((void*)data, size);
+            ::close(fd);
+#endif
+            data = nullptr;
+        }
+    };
+}
@@ -0,0 +1,272 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module tornasol:font;
+
+import :arena;
+import :image;
+import :rect;
+import :texture;
+import :types;
+
+import <algorithm>;
+import <cmath>;
+import <format>;
+import <functional>;
+import <iterator>;
+import <memory>;
+import <memory_resource>;
+import <string>;
+import <string_view>;
+import <unordered_map>;
+import <vector>;
+
+export namespace tornasol {
+
+    // Segments of a 14-segment display, plus the decimal point:
+    //
+    //    ---a---
+    //   |\  |  /|
+    //   f h j k b
+    //   |  \|/  |
+    //    -g1-g2-
+    //   |  /|\  |
+    //   e l m n c
+    //   |/  |  \|
+    //    ---d---  .
+    //
+    enum segment : u16
+    {
+        seg_a  = 1 << 0,  seg_b  = 1 << 1,  seg_c  = 1 << 2,
+        seg_d  = 1 << 3,  seg_e  = 1 << 4,  seg_f  = 1 << 5,
+        seg_g1 = 1 << 6,  seg_g2 = 1 << 7,  seg_h  = 1 << 8,
+        seg_j  = 1 << 9,  seg_k  = 1 << 10, seg_l  = 1 << 11,
+        seg_m  = 1 << 12, seg_n  = 1 << 13, seg_dp = 1 << 14,
+    };
+
+    // Lit segments of the glyphs, ascii ' ' to '_'. Lowercase is drawn as
+    // uppercase, anything else is blank.
+    constexpr u16 segment_glyphs[64] = {
+        0x0000, 0x0006, 0x0220, 0x12ce, 0x12ed, 0x0c24, 0x235d, 0x0400, // ' '..'''
+        0x2400, 0x0900, 0x3fc0, 0x12c0, 0x0800, 0x00c0, 0x4000, 0x0c00, // '('..'/'
+        0x0c3f, 0x0006, 0x00db, 0x008f, 0x00e6, 0x2069, 0x00fd, 0x0007, // '0'..'7'
+        0x00ff, 0x00ef, 0x1200, 0x0a00, 0x2400, 0x00c8, 0x0900, 0x1083, // '8'..'?'
+        0x02bb, 0x00f7, 0x128f, 0x0039, 0x120f, 0x00f9, 0x0071, 0x00bd, // '@'..'G'
+        0x00f6, 0x1209, 0x001e, 0x2470, 0x0038, 0x0536, 0x2136, 0x003f, // 'H'..'O'
+        0x00f3, 0x203f, 0x20f3, 0x00ed, 0x1201, 0x003e, 0x0c30, 0x2836, // 'P'..'W'
+        0x2d00, 0x1500, 0x0c09, 0x0039, 0x2100, 0x000f, 0x0c03, 0x0008, // 'X'..'_'
+    };
+
+    // Layout of the distance field atlas, 16 x 4 cells.
+    struct font_metrics {
+        static constexpr i32 cell_w   = 32;
+        static constexpr i32 cell_h   = 48;
+        static constexpr i32 columns  = 16;
+        static constexpr i32 rows     = 4;
+        static constexpr i32 pad      = 6;  // around the glyph box
+        static constexpr i32 glyph_w  = cell_w - 2 * pad;
+        static constexpr i32 glyph_h  = cell_h - 2 * pad;
+        static constexpr f32 stroke   = 2.5f; // half width, in pixels
+        static constexpr f32 spread   = 6.0f; // distance at 0 and 255
+        static constexpr f32 spacing  = 6.0f;
+        static constexpr char first   = ' ';
+    };
+
+    // Bakes the segment font into an rgba atlas, white with the signed
+    // distance to the strokes in alpha, 0.5 on the edge. Rows are flipped
+    // for gl like decoded images. Done offline by the cooker, or on the 
+    // spot when no pack has it.
+    image bake_segment_font()
+    {
+        using m = font_metrics;
+
+        struct line { f32 x0, y0, x1, y1; };
+
+        // segment endpoints in the glyph box, y down
+        const f32 l = 0.0f, r = 1.0f, c = 0.5f, t = 0.0f, mid = 0.5f, b = 1.0f;
+        const line lines[15] = {
+            { l, t, r, t },     { r, t, r, mid },   { r, mid, r, b },
+            { l, b, r, b },     { l, mid, l, b },   { l, t, l, mid },
+            { l, mid, c, mid }, { c, mid, r, mid }, { l, t, c, mid },
+            { c, t, c, mid },   { r, t, c, mid },   { c, mid, l, b },
+            { c, mid, c, b },   { c, mid, r, b },   { c, b, c, b }
+        };
+
+        const i32 w = m::cell_w * m::columns;
+        const i32 h = m::cell_h * m::rows;
+        image atlas(w, h, 4);
+
+        for (i32 g = 0; g < 64; ++g)
+        {
+            const i32 cx = (g % m::columns) * m::cell_w;
+            const i32 cy = (g / m::columns) * m::cell_h;
+
+            for (i32 y = 0; y < m::cell_h; ++y)
+            for (i32 x = 0; x < m::cell_w; ++x)
+            {
+                const f32 px = x + 0.5f - m::pad;
+                const f32 py = y + 0.5f - m::pad;
+                f32 dist = m::spread + m::stroke;
+
+                for (u32 s = 0; s < 15; ++s)
+                {
+                    if (!(segment_glyphs[g] & (1 << s)))
+                        continue;
+
+                    const line& ln = lines[s];
+                    const f32 ax = ln.x0 * m::glyph_w, ay = ln.y0 * m::glyph_h;
+                    const f32 bx = ln.x1 * m::glyph_w, by = ln.y1 * m::glyph_h;
+                    const f32 dx = bx - ax, dy = by - ay;
+                    const f32 len = dx * dx + dy * dy;
+
+                    f32 k = len > 0.0f 
+                        ? ((px - ax) * dx + (py - ay) * dy) / len : 0.0f;
+                    k = std::clamp(k, 0.0f, 1.0f);
+
+                    const f32 ex = px - (ax + k * dx), ey = py - (ay + k * dy);
+                    dist = std::min(dist, std::sqrt(ex * ex + ey * ey));
+                }
+
+                const f32 sd = dist - m::stroke; // negative inside
+                const f32 v = std::clamp(0.5f - sd / (2.0f * m::spread), 
+                    0.0f, 1.0f);
+
+                byte* p = atlas.data 
+                    + ((usize)(h - 1 - (cy + y)) * w + cx + x) * 4;
+                p[0] = p[1] = p[2] = byte{ 255 };
+                p[3] = (byte)(v * 255.0f + 0.5f);
+            }
+        }
+
+        return atlas;
+    }
+
+    struct glyph_quad {
+        rect<> area; // top-left origin, relative to the text
+        rect<> uv;   // in the atlas, gl orientation
+    };
+
+    // Glyph quads of a string, ready to be drawn with the font atlas.
+    struct shaped_text {
+        std::vector<glyph_quad> quads;
+        f32 width;
+        f32 height;
+    };
+
+    // Lays out text in the baked segment font. Shaped strings are cached, 
+    // drawing the same total or label again costs no layout and no memory.
+    // Not thread safe, shape from one thread.
+    class font {
+    private:
+        static constexpr usize max_cached = 512;
+
+        // looks keys up without making a std::string of them
+        struct key_hash {
+            using is_transparent = void;
+
+            usize operator()(std::string_view key) const {
+                return std::hash<std::string_view>()(key);
+            }
+        };
+
+        shared<texture> atlas;
+        std::unordered_map<std::string, shared<const shaped_text>, 
+            key_hash, std::equal_to<>> cache;
+
+    public:
+        // the atlas flagged as a distance field for the sprite shader
+        font(shared<texture> atlas)
+            : atlas(std::move(atlas))
+        {
+            this->atlas->set_distance_field(true);
+        }
+
+        // non-copyable
+        font(const font&) = delete;
+        font& operator=(const font&) = delete;
+
+        const shared<texture>& get_atlas() const {
+            return atlas;
+        }
+
+        // size is the height of capitals, in pixels
+        shared<const shaped_text> shape(std::string_view text, f32 size)
+        {
+            // a hit costs no heap memory, only a miss keeps its key
+            std::pmr::string key(&get_frame_arena());
+            std::format_to(std::back_inserter(key), "{}@{}", text, size);
+
+            auto it = cache.find(std::string_view(key));
+            if (it != cache.end())
+                return it->second;
+
+            if (cache.size() >= max_cached)
+                cache.clear();
+
+            auto shaped = std::make_shared<shaped_text>(layout(text, size));
+            cache.emplace(std::string(key), shaped);
+            return shaped;
+        }
+
+    private:
+        static shaped_text layout(std::string_view text, f32 size)
+        {
+            using m = font_metrics;
+
+            const f32 scale = size / m::glyph_h;
+            const f32 atlas_w = (f32)(m::cell_w * m::columns);
+            const f32 atlas_h = (f32)(m::cell_h * m::rows);
+
+            shaped_text shaped = {};
+            shaped.quads.reserve(text.size());
+            shaped.height = size;
+            f32 pen = 0.0f;
+
+            for (char ch : text)
+            {
+                if (ch >= 'a' && ch <= 'z')
+                    ch = ch - 'a' + 'A';
+
+                i32 g = ch - m::first;
+                if (g < 0 || g >= 64)
+                    g = 0;
+
+                if (segment_glyphs[g])
+                {
+                    const f32 col = (f32)(g % m::columns);
+                    const f32 row = (f32)(g / m::columns);
+
+                    shaped.quads.push_back({
+                        { pen - m::pad * scale, -m::pad * scale, 
+                          m::cell_w * scale, m::cell_h * scale },
+                        { col * m::cell_w / atlas_w, 
+                          1.0f - (row + 1.0f) * m::cell_h / atlas_h,
+                          m::cell_w / atlas_w, m::cell_h / atlas_h }
+                    });
+                }
+
+                pen += (m::glyph_w + m::spacing) * scale;
+            }
+
+            shaped.width = std::max(pen - m::spacing * scale, 0.0f);
+            return shaped;
+        }
+    };
+}
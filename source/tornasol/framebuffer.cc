@@ -0,0 +1,150 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module tornasol:framebuffer;
+
+import :gl;
+import :size;
+import :texture;
+import :types;
+
+import <memory>;
+import <stdexcept>;
+
+export namespace tornasol {
+
+    // Offscreen render target: a color texture, which can be sampled 
+    // afterwards, plus a depth/stencil renderbuffer. A multisampled one
+    // keeps its color in a renderbuffer instead, it is read by resolving
+    // it into a single sampled framebuffer.
+    class framebuffer {
+    private:
+        u32 id;
+        u32 depth;
+        u32 msaa; // multisampled color, 0 if single sampled
+        u32 samples;
+        size2<i32> size;
+        shared<texture> color;
+
+    public:
+        framebuffer(size2<i32> size, u32 samples = 0)
+            : id(gl::gen_framebuffer()), depth(gl::gen_renderbuffer()),
+              msaa(samples ? gl::gen_renderbuffer() : 0), samples(samples),
+              size({ 0, 0 }), 
+              color(samples ? nullptr : std::make_shared<texture>())
+        {
+            resize(size);
+        }
+
+        ~framebuffer() 
+        {
+            if (msaa)
+                gl::delete_renderbuffer(msaa);
+
+            gl::delete_renderbuffer(depth);
+            gl::delete_framebuffer(id);
+        }
+
+        // non-copyable
+        framebuffer(const framebuffer&) = delete;
+        framebuffer& operator=(const framebuffer&) = delete;
+
+        u32 get_id() const {
+            return id;
+        }
+
+        size2<i32> get_size() const {
+            return size;
+        }
+
+        u32 get_samples() const {
+            return samples;
+        }
+
+        // nullptr when multisampled, see resolve
+        shared<texture> get_color() const {
+            return color;
+        }
+
+        void bind() {
+            gl::bind_framebuffer(gl::framebuffer, id);
+        }
+
+        // back to the window's framebuffer
+        void unbind() {
+            gl::bind_framebuffer(gl::framebuffer, 0);
+        }
+
+        // Reallocates the attachments, leaves the framebuffer bound.
+        void resize(size2<i32> size)
+        {
+            this->size = size;
+
+            if (msaa)
+            {
+                gl::bind_renderbuffer(gl::renderbuffer, msaa);
+                gl::renderbuffer_storage_multisample(gl::renderbuffer, 
+                    samples, gl::rgba8, size.w, size.h);
+
+                gl::bind_renderbuffer(gl::renderbuffer, depth);
+                gl::renderbuffer_storage_multisample(gl::renderbuffer, 
+                    samples, gl::depth24_stencil8, size.w, size.h);
+
+                bind();
+                gl::framebuffer_renderbuffer(gl::framebuffer, 
+                    gl::color_attachment0, gl::renderbuffer, msaa);
+            }
+            else 
+            {
+                color->bind();
+                color->set_filter(texture_filter::linear, 
+                    texture_filter::linear);
+                color->allocate(size);
+
+                gl::bind_renderbuffer(gl::renderbuffer, depth);
+                gl::renderbuffer_storage(gl::renderbuffer, 
+                    gl::depth24_stencil8, size.w, size.h);
+
+                bind();
+                gl::framebuffer_texture_2d(gl::framebuffer, 
+                    gl::color_attachment0, gl::texture_2d, color->get_id(), 0);
+            }
+
+            gl::framebuffer_renderbuffer(gl::framebuffer, 
+                gl::depth_stencil_attach, gl::renderbuffer, depth);
+
+            if (gl::check_framebuffer_status(gl::framebuffer) 
+                != gl::framebuffer_complete)
+                throw std::runtime_error("incomplete framebuffer");
+        }
+
+        // Copies the color into another framebuffer, averaging the samples
+        // when multisampled. Leaves no framebuffer bound.
+        void resolve(framebuffer& dst)
+        {
+            gl::bind_framebuffer(gl::read_framebuffer, id);
+            gl::bind_framebuffer(gl::draw_framebuffer, dst.id);
+            gl::blit_framebuffer(0, 0, size.w, size.h, 
+                0, 0, dst.size.w, dst.size.h, gl::color_buffer_bit, 
+                size == dst.size ? gl::nearest : gl::linear);
+            gl::bind_framebuffer(gl::framebuffer, 0);
+        }
+    };
+}
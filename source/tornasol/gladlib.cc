@@ -44,6 +44,10 @@ namespace tornasol {
         glad_dep(glad::load_proc proc)
             : proc(proc) {}
 
+        glad::load_proc get_proc() const {
+            return proc;
+        }
+
         void load() {
             if (!glad::load_gl_loader(proc))
                 throw std::runtime_error("failed to load glad");
@@ -125,7 +125,8 @@ export namespace tornasol::glfw {
         context_release_behavior = GLFW_CONTEXT_RELEASE_BEHAVIOR,
         gl_forward_compat        = GLFW_OPENGL_FORWARD_COMPAT,
         gl_debug_context         = GLFW_OPENGL_DEBUG_CONTEXT,
-        gl_profile               = GLFW_OPENGL_PROFILE
+        gl_profile               = GLFW_OPENGL_PROFILE,
+        context_creation_api     = GLFW_CONTEXT_CREATION_API
     };  
      
     enum class client_api
@@ -135,6 +136,13 @@ export namespace tornasol::glfw {
         none      = GLFW_NO_API
     };
 
+    enum class context_api
+    {
+        native = GLFW_NATIVE_CONTEXT_API,
+        egl    = GLFW_EGL_CONTEXT_API,
+        osmesa = GLFW_OSMESA_CONTEXT_API
+    };
+
     enum class gl_profile
     {
         any           = GLFW_OPENGL_ANY_PROFILE,
@@ -22,6 +22,141 @@ export module tornasol:gl;
 import :types;
 import "glad.h";
 
+import <string_view>;
+
+namespace tornasol::gl 
+{
+    // What the context has bound, as far as these wrappers know. Binds and
+    // toggles that would not change it are skipped. A context is current
+    // on one thread only, so each thread shadows its own.
+    struct shadow_state {
+        static constexpr u32 unknown = ~0u;
+        static constexpr u32 max_caps = 8;
+
+        struct capability {
+            u32 cap;
+            bool enabled;
+        };
+
+        u32 program               = unknown;
+        u32 vertex_array          = unknown;
+        u32 array_buffer          = unknown;
+        u32 element_buffer        = unknown; // part of the vertex array
+        u32 pixel_unpack_buffer   = unknown;
+        u32 texture_2d            = unknown;
+        u32 framebuffer           = unknown;
+        u32 blend_src             = unknown;
+        u32 blend_dst             = unknown;
+        u32 depth_func            = unknown;
+        u32 depth_write           = unknown;
+        i32 viewport[4]           = { -1, -1, -1, -1 };
+        i32 scissor[4]            = { -1, -1, -1, -1 };
+        capability caps[max_caps] = {};
+        u32 cap_count             = 0;
+        // counters
+        u64 changes               = 0;
+        u64 elided                = 0;
+
+        // Records a new value, false when it is already set.
+        bool set(u32& slot, u32 value)
+        {
+            if (slot == value) {
+                ++elided;
+                return false;
+            }
+
+            slot = value;
+            ++changes;
+            return true;
+        }
+
+        bool set(i32 (&slot)[4], i32 x, i32 y, i32 w, i32 h)
+        {
+            if (slot[0] == x && slot[1] == y && slot[2] == w && slot[3] == h) {
+                ++elided;
+                return false;
+            }
+
+            slot[0] = x; slot[1] = y; slot[2] = w; slot[3] = h;
+            ++changes;
+            return true;
+        }
+
+        bool set_cap(u32 cap, bool enabled)
+        {
+            for (u32 i = 0; i < cap_count; ++i)
+            {
+                if (caps[i].cap != cap)
+                    continue;
+
+                if (caps[i].enabled == enabled) {
+                    ++elided;
+                    return false;
+                }
+
+                caps[i].enabled = enabled;
+                ++changes;
+                return true;
+            }
+
+            // untracked once the table is full
+            if (cap_count < max_caps)
+                caps[cap_count++] = { cap, enabled };
+
+            ++changes;
+            return true;
+        }
+
+        u32* buffer(u32 target)
+        {
+            switch (target) {
+            case GL_ARRAY_BUFFER:         return &array_buffer;
+            case GL_ELEMENT_ARRAY_BUFFER: return &element_buffer;
+            case GL_PIXEL_UNPACK_BUFFER:  return &pixel_unpack_buffer;
+            default:                      return nullptr;
+            }
+        }
+
+        // a deleted object that was bound leaves zero bound
+        void forget(u32& slot, u32 id) 
+        {
+            if (slot == id)
+                slot = 0;
+        }
+    };
+
+    thread_local shadow_state shadow;
+
+    // entry points newer than the 4.0 loader, see load_extensions
+    using buffer_storage_proc = 
+        void (APIENTRY*)(GLenum, GLsizeiptr, const void*, GLbitfield);
+    using tex_storage_2d_proc = 
+        void (APIENTRY*)(GLenum, GLsizei, GLenum, GLsizei, GLsizei);
+
+    buffer_storage_proc buffer_storage_fn = nullptr;
+    tex_storage_2d_proc tex_storage_2d_fn = nullptr;
+
+    bool has_version(i32 major, i32 minor) {
+        return GLVersion.major > major 
+            || (GLVersion.major == major && GLVersion.minor >= minor);
+    }
+
+    bool has_extension(std::string_view extension)
+    {
+        i32 count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+        for (i32 i = 0; i < count; ++i)
+        {
+            auto name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            if (name && extension == name)
+                return true;
+        }
+
+        return false;
+    }
+}
+
 export namespace tornasol::gl 
 {
     enum def : u32
@@ -69,6 +204,21 @@ export namespace tornasol::gl
         // buffer type  
         array_buffer         = GL_ARRAY_BUFFER,
         element_buffer       = GL_ELEMENT_ARRAY_BUFFER,
+        pixel_unpack_buffer  = GL_PIXEL_UNPACK_BUFFER,
+        // buffer access
+        write_only           = GL_WRITE_ONLY,
+        map_write_bit        = GL_MAP_WRITE_BIT,
+        map_invalidate_range = GL_MAP_INVALIDATE_RANGE_BIT,
+        map_unsynchronized   = GL_MAP_UNSYNCHRONIZED_BIT,
+        map_persistent_bit   = 0x0040, // GL_MAP_PERSISTENT_BIT, 4.4
+        map_coherent_bit     = 0x0080, // GL_MAP_COHERENT_BIT, 4.4
+        // sync
+        sync_gpu_complete    = GL_SYNC_GPU_COMMANDS_COMPLETE,
+        sync_flush_commands  = GL_SYNC_FLUSH_COMMANDS_BIT,
+        already_signaled     = GL_ALREADY_SIGNALED,
+        condition_satisfied  = GL_CONDITION_SATISFIED,
+        timeout_expired      = GL_TIMEOUT_EXPIRED,
+        wait_failed          = GL_WAIT_FAILED,
         // draw
         static_draw          = GL_STATIC_DRAW,
         dynamic_draw         = GL_DYNAMIC_DRAW,
@@ -79,28 +229,76 @@ export namespace tornasol::gl
         texture_wrap_t       = GL_TEXTURE_WRAP_T,
         texture_min_filter   = GL_TEXTURE_MIN_FILTER,
         texture_mag_filter   = GL_TEXTURE_MAG_FILTER,
+        texture_base_level   = GL_TEXTURE_BASE_LEVEL,
+        texture_max_level    = GL_TEXTURE_MAX_LEVEL,
         repeat               = GL_REPEAT,
         linear               = GL_LINEAR,
         nearest              = GL_NEAREST,
         linear_mipmap_linear = GL_LINEAR_MIPMAP_LINEAR,   
+        unpack_alignment     = GL_UNPACK_ALIGNMENT,
         // color
         red                  = GL_RED,
         green                = GL_GREEN,
         blue                 = GL_BLUE,
         rgb                  = GL_RGB,
         rgba                 = GL_RGBA,
+        rgb8                 = GL_RGB8,
+        rgba8                = GL_RGBA8,
+        depth24_stencil8     = GL_DEPTH24_STENCIL8,
         // blending
         blend                = GL_BLEND,
+        one                  = GL_ONE,
         one_minus_src_alpha  = GL_ONE_MINUS_SRC_ALPHA,
         one_minus_dst_alpha  = GL_ONE_MINUS_DST_ALPHA,
         src_alpha            = GL_SRC_ALPHA,
         dst_alpha            = GL_DST_ALPHA,
+        // depth
+        depth_test           = GL_DEPTH_TEST,
+        less                 = GL_LESS,
+        lequal               = GL_LEQUAL,
+        always               = GL_ALWAYS,
         // anti-aliasing
         multisample          = GL_MULTISAMPLE,
+        // clipping
+        scissor_test         = GL_SCISSOR_TEST,
+        // framebuffer
+        framebuffer          = GL_FRAMEBUFFER,
+        renderbuffer         = GL_RENDERBUFFER,
+        read_framebuffer     = GL_READ_FRAMEBUFFER,
+        draw_framebuffer     = GL_DRAW_FRAMEBUFFER,
+        color_attachment0    = GL_COLOR_ATTACHMENT0,
+        depth_stencil_attach = GL_DEPTH_STENCIL_ATTACHMENT,
+        framebuffer_complete = GL_FRAMEBUFFER_COMPLETE,
+        // queries
+        time_elapsed         = GL_TIME_ELAPSED,
+        query_result         = GL_QUERY_RESULT,
+        query_available      = GL_QUERY_RESULT_AVAILABLE,
     };
 
+    // Forgets the shadowed state, for when something else touched the 
+    // context.
+    void invalidate_state() 
+    {
+        u64 changes = shadow.changes;
+        u64 elided = shadow.elided;
+        shadow = {};
+        shadow.changes = changes;
+        shadow.elided = elided;
+    }
+
+    // state calls that went through to gl
+    u64 get_state_changes() {
+        return shadow.changes;
+    }
+
+    // state calls skipped because nothing would have changed
+    u64 get_elided_calls() {
+        return shadow.elided;
+    }
+
     void viewport(i32 x, i32 y, i32 width, i32 height) {
-        glViewport(x, y, width, height);
+        if (shadow.set(shadow.viewport, x, y, width, height))
+            glViewport(x, y, width, height);
     }
 
     void clear_color(f32 r, f32 g, f32 b, f32 a) {
@@ -117,30 +315,84 @@ export namespace tornasol::gl
         return id;
     }
 
-    void delete_buffer(u32 id) {
+    void delete_buffer(u32 id) 
+    {
+        shadow.forget(shadow.array_buffer, id);
+        shadow.forget(shadow.element_buffer, id);
+        shadow.forget(shadow.pixel_unpack_buffer, id);
         glDeleteBuffers(1, &id);
     }
 
-    void bind_buffer(def target, u32 id) {
-        glBindBuffer(target, id);
+    void bind_buffer(def target, u32 id) 
+    {
+        u32* slot = shadow.buffer(target);
+        if (!slot || shadow.set(*slot, id))
+            glBindBuffer(target, id);
     }
 
     void buffer_data(def target, i32 size, const void* data, def usage) {
         glBufferData(target, size, data, usage);
     }
 
+    void* map_buffer(def target, def access) {
+        return glMapBuffer(target, access);
+    }
+
+    void* map_buffer_range(def target, isize offset, isize length, 
+        u32 access) 
+    {
+        return glMapBufferRange(target, offset, length, access);
+    }
+
+    // Looks up the entry points past 4.0 the context has, glBufferStorage
+    // (4.4 or ARB_buffer_storage) and glTexStorage2D (4.2 or 
+    // ARB_texture_storage). Expects a current context.
+    void load_extensions(void* (*load)(const char*))
+    {
+        buffer_storage_fn = 
+            has_version(4, 4) || has_extension("GL_ARB_buffer_storage")
+            ? (buffer_storage_proc)load("glBufferStorage") : nullptr;
+
+        tex_storage_2d_fn = 
+            has_version(4, 2) || has_extension("GL_ARB_texture_storage")
+            ? (tex_storage_2d_proc)load("glTexStorage2D") : nullptr;
+    }
+
+    bool has_buffer_storage() {
+        return buffer_storage_fn != nullptr;
+    }
+
+    // Immutable storage, expects has_buffer_storage().
+    void buffer_storage(def target, isize size, const void* data, u32 flags) {
+        buffer_storage_fn(target, size, data, flags);
+    }
+
+    bool unmap_buffer(def target) {
+        return glUnmapBuffer(target);
+    }
+
     u32 gen_vertex_array() {
         u32 id;
         glGenVertexArrays(1, &id);
         return id;
     }
 
-    void delete_vertex_array(u32 id) {
+    void delete_vertex_array(u32 id) 
+    {
+        if (shadow.vertex_array == id) {
+            shadow.vertex_array = 0;
+            shadow.element_buffer = shadow_state::unknown;
+        }
+
         glDeleteVertexArrays(1, &id);
     }
 
-    void bind_vertex_array(u32 id) {
-        glBindVertexArray(id);
+    void bind_vertex_array(u32 id) 
+    {
+        if (shadow.set(shadow.vertex_array, id)) {
+            glBindVertexArray(id);
+            shadow.element_buffer = shadow_state::unknown;
+        }
     }
 
     void vertex_attrib_pointer(u32 index, i32 size, def type, 
@@ -190,7 +442,9 @@ export namespace tornasol::gl
         return glCreateProgram();
     }
 
-    void delete_program(u32 program) {
+    void delete_program(u32 program)
+    {
+        shadow.forget(shadow.program, program);
         glDeleteProgram(program);
     }
 
@@ -213,7 +467,8 @@ export namespace tornasol::gl
     }
 
     void use_program(u32 program) {
-        glUseProgram(program);
+        if (shadow.set(shadow.program, program))
+            glUseProgram(program);
     }
 
     i32 get_attrib_location(u32 program, const char* name) {
@@ -281,11 +536,13 @@ export namespace tornasol::gl
     }
 
     void delete_texture(u32 id) {
+        shadow.forget(shadow.texture_2d, id);
         glDeleteTextures(1, &id);
     }
 
     void bind_texture(def target, u32 id) {
-        glBindTexture(target, id);
+        if (target != texture_2d || shadow.set(shadow.texture_2d, id))
+            glBindTexture(target, id);
     }
 
     void tex_parameteri(def target, def pname, i32 param) {
@@ -303,22 +560,190 @@ export namespace tornasol::gl
             border, format, type, data);
     }
 
+    bool has_tex_storage() {
+        return tex_storage_2d_fn != nullptr;
+    }
+
+    // Immutable storage for every level, expects has_tex_storage().
+    void tex_storage_2d(def target, i32 levels, def internal_format, 
+        i32 width, i32 height) 
+    {
+        tex_storage_2d_fn(target, levels, internal_format, width, height);
+    }
+
+    void tex_sub_image_2d(def target, i32 level, i32 x, i32 y, 
+        i32 width, i32 height, def format, def type, const void* data) 
+    {
+        glTexSubImage2D(target, level, x, y, width, height, format, type, 
+            data);
+    }
+
+    void pixel_store_i(def pname, i32 param) {
+        glPixelStorei(pname, param);
+    }
+
     void generate_mipmap(def target) {
         glGenerateMipmap(target);
     }
     
+    u32 gen_framebuffer() {
+        u32 id;
+        glGenFramebuffers(1, &id);
+        return id;
+    }
+
+    void delete_framebuffer(u32 id) {
+        shadow.forget(shadow.framebuffer, id);
+        glDeleteFramebuffers(1, &id);
+    }
+
+    void bind_framebuffer(def target, u32 id) 
+    {
+        if (target != framebuffer)
+            shadow.framebuffer = shadow_state::unknown;
+
+        if (target != framebuffer || shadow.set(shadow.framebuffer, id))
+            glBindFramebuffer(target, id);
+    }
+
+    void framebuffer_texture_2d(def target, def attachment, def textarget,
+        u32 texture, i32 level)
+    {
+        glFramebufferTexture2D(target, attachment, textarget, texture, level);
+    }
+
+    def check_framebuffer_status(def target) {
+        return (def)glCheckFramebufferStatus(target);
+    }
+
+    u32 gen_renderbuffer() {
+        u32 id;
+        glGenRenderbuffers(1, &id);
+        return id;
+    }
+
+    void delete_renderbuffer(u32 id) {
+        glDeleteRenderbuffers(1, &id);
+    }
+
+    void bind_renderbuffer(def target, u32 id) {
+        glBindRenderbuffer(target, id);
+    }
+
+    void renderbuffer_storage(def target, def internal_format, 
+        i32 width, i32 height)
+    {
+        glRenderbufferStorage(target, internal_format, width, height);
+    }
+
+    void renderbuffer_storage_multisample(def target, i32 samples, 
+        def internal_format, i32 width, i32 height)
+    {
+        glRenderbufferStorageMultisample(target, samples, internal_format, 
+            width, height);
+    }
+
+    // the read and draw framebuffers must be bound first
+    void blit_framebuffer(i32 src_x0, i32 src_y0, i32 src_x1, i32 src_y1,
+        i32 dst_x0, i32 dst_y0, i32 dst_x1, i32 dst_y1, def mask, def filter)
+    {
+        glBlitFramebuffer(src_x0, src_y0, src_x1, src_y1, 
+            dst_x0, dst_y0, dst_x1, dst_y1, mask, filter);
+    }
+
+    void framebuffer_renderbuffer(def target, def attachment, 
+        def renderbuffer_target, u32 renderbuffer)
+    {
+        glFramebufferRenderbuffer(target, attachment, renderbuffer_target, 
+            renderbuffer);
+    }
+
+    void finish() {
+        glFinish();
+    }
+
+    using sync = GLsync;
+
+    sync fence_sync() {
+        return glFenceSync(sync_gpu_complete, 0);
+    }
+
+    def client_wait_sync(sync fence, u32 flags, u64 timeout) {
+        return (def)glClientWaitSync(fence, flags, timeout);
+    }
+
+    void delete_sync(sync fence) {
+        glDeleteSync(fence);
+    }
+
     void enable(def cap) {
-        glEnable(cap);
+        if (shadow.set_cap(cap, true))
+            glEnable(cap);
+    }
+
+    void disable(def cap) {
+        if (shadow.set_cap(cap, false))
+            glDisable(cap);
+    }
+
+    void scissor(i32 x, i32 y, i32 width, i32 height) {
+        if (shadow.set(shadow.scissor, x, y, width, height))
+            glScissor(x, y, width, height);
     }
 
-    void blend_func(def sfactor, def dfactor) {
+    void blend_func(def sfactor, def dfactor) 
+    {
+        if (shadow.blend_src == sfactor && shadow.blend_dst == dfactor) {
+            ++shadow.elided;
+            return;
+        }
+
+        shadow.blend_src = sfactor;
+        shadow.blend_dst = dfactor;
+        ++shadow.changes;
         glBlendFunc(sfactor, dfactor);
     }
 
+    void depth_func(def func) {
+        if (shadow.set(shadow.depth_func, func))
+            glDepthFunc(func);
+    }
+
+    void depth_mask(bool write) {
+        if (shadow.set(shadow.depth_write, write ? 1 : 0))
+            glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+
     void polygon_mode(def face, def mode) {
         glPolygonMode(face, mode);
     }
 
+    u32 gen_query() {
+        u32 id;
+        glGenQueries(1, &id);
+        return id;
+    }
+
+    void delete_query(u32 id) {
+        glDeleteQueries(1, &id);
+    }
+
+    void begin_query(def target, u32 id) {
+        glBeginQuery(target, id);
+    }
+
+    void end_query(def target) {
+        glEndQuery(target);
+    }
+
+    void get_query_object_uiv(u32 id, def pname, u32* params) {
+        glGetQueryObjectuiv(id, pname, params);
+    }
+
+    void get_query_object_ui64v(u32 id, def pname, u64* params) {
+        glGetQueryObjectui64v(id, pname, params);
+    }
+
     void draw_arrays(def mode, i32 first, i32 count) {
         glDrawArrays(mode, first, count);
     }
@@ -326,4 +751,10 @@ export namespace tornasol::gl
     void draw_elements(def mode, i32 count, def type, void* indices) {
         glDrawElements(mode, count, type, indices);
     }
+
+    void draw_elements_base_vertex(def mode, i32 count, def type, 
+        void* indices, i32 base_vertex) 
+    {
+        glDrawElementsBaseVertex(mode, count, type, indices, base_vertex);
+    }
 }
\ No newline at end of file
@@ -22,7 +22,39 @@ export module tornasol:image;
 
 import :types;
 import :stbi;
+
+import <algorithm>;
 import <filesystem>;
+import <span>;
+import <utility>;
+import <vector>;
+
+namespace tornasol
+{
+   // One row of a 2x2 box downsample with the channel count known at 
+   // compile time, so the loop over pixel pairs is flat and vectorizes.
+   template <i32 C>
+   void downsample_row(const byte* r0, const byte* r1, byte* d, i32 w, 
+      i32 src_w)
+   {
+      const i32 pairs = src_w / 2;
+
+      for (i32 x = 0; x < pairs; ++x)
+      {
+         const byte* p0 = r0 + x * 2 * C;
+         const byte* p1 = r1 + x * 2 * C;
+
+         for (i32 k = 0; k < C; ++k)
+            d[x * C + k] = (byte)(((u32)p0[k] + (u32)p0[k + C] 
+               + (u32)p1[k] + (u32)p1[k + C] + 2) >> 2);
+      }
+
+      // a single column
+      if (pairs < w)
+         for (i32 k = 0; k < C; ++k)
+            d[k] = (byte)(((u32)r0[k] + (u32)r1[k] + 1) >> 1);
+   }
+}
 
 export namespace tornasol
 {
@@ -33,16 +65,158 @@ export namespace tornasol
       i32   channels;
       byte* data;
 
+      image()
+         : width(0), height(0), channels(0), data(nullptr) {}
+
+      image(i32 width, i32 height, i32 channels)
+         : width(width), height(height), channels(channels),
+           data(stbi::alloc((usize)width * height * channels)) {}
+
       image(fs::path path) 
       {
-         stbi::set_flip_vertically_on_load(true);
+         stbi::set_flip_vertically_on_load_thread(true);
 
          data = stbi::load(path.string().c_str(), 
             &width, &height, &channels, 0);
       }
 
+      // decodes an encoded image (png, jpg...) already in memory, e.g. a raw
+      // entry of a mapped asset_pack
+      image(std::span<const byte> encoded)
+      {
+         stbi::set_flip_vertically_on_load_thread(true);
+
+         data = stbi::load_from_memory(encoded.data(), (int)encoded.size(),
+            &width, &height, &channels, 0);
+      }
+
       ~image() {
          stbi::free(data);
       }
+
+      // non-copyable
+      image(const image&) = delete;
+      image& operator=(const image&) = delete;
+
+      // movable
+      image(image&& other)
+         : width(other.width), height(other.height), 
+           channels(other.channels), data(other.data)
+      {
+         other.data = nullptr;
+      }
+
+      image& operator=(image&& other)
+      {
+         if (this == &other)
+            return *this;
+
+         stbi::free(data);
+         width = other.width;
+         height = other.height;
+         channels = other.channels;
+         data = other.data;
+         other.data = nullptr;
+         return *this;
+      }
+
+      usize get_size() const {
+         return (usize)width * height * channels;
+      }
    };    
+
+   // Expands rgb pixels to rgba with an opaque alpha channel.
+   image to_rgba(const image& src)
+   {
+      image dst(src.width, src.height, 4);
+      const usize count = (usize)src.width * src.height;
+
+      for (usize i = 0; i < count; ++i)
+      {
+         const byte* s = src.data + i * src.channels;
+         byte* d = dst.data + i * 4;
+
+         d[0] = s[0];
+         d[1] = src.channels > 1 ? s[1] : s[0];
+         d[2] = src.channels > 2 ? s[2] : s[0];
+         d[3] = src.channels > 3 ? s[3] : byte{ 255 };
+      }
+
+      return dst;
+   }
+
+   // Multiplies the color of rgba pixels by their alpha, so filtering and
+   // blending do not bleed the color of fully transparent texels.
+   void premultiply_alpha(image& img)
+   {
+      const usize count = (usize)img.width * img.height;
+
+      for (usize i = 0; i < count; ++i)
+      {
+         byte* p = img.data + i * 4;
+         const u32 a = (u32)p[3];
+
+         p[0] = (byte)(((u32)p[0] * a + 127) / 255);
+         p[1] = (byte)(((u32)p[1] * a + 127) / 255);
+         p[2] = (byte)(((u32)p[2] * a + 127) / 255);
+      }
+   }
+
+   // True when no pixel is see-through, the image can be drawn without 
+   // blending. Images without an alpha channel always are.
+   bool is_opaque(const image& img)
+   {
+      const i32 c = img.channels;
+      if (c != 2 && c != 4)
+         return true;
+
+      const usize count = (usize)img.width * img.height;
+      for (usize i = 0; i < count; ++i)
+         if (img.data[i * c + c - 1] != byte{ 255 })
+            return false;
+
+      return true;
+   }
+
+   // Halves an image with a 2x2 box filter, the next level of its mip 
+   // chain. An odd last row/column is dropped, a single one is reused.
+   image downsample(const image& src)
+   {
+      const i32 w = src.width > 1 ? src.width / 2 : 1;
+      const i32 h = src.height > 1 ? src.height / 2 : 1;
+      const i32 c = src.channels;
+      const usize stride = (usize)src.width * c;
+
+      image dst(w, h, c);
+
+      for (i32 y = 0; y < h; ++y)
+      {
+         const i32 y0 = std::min(y * 2, src.height - 1);
+         const i32 y1 = std::min(y * 2 + 1, src.height - 1);
+         const byte* r0 = src.data + (usize)y0 * stride;
+         const byte* r1 = src.data + (usize)y1 * stride;
+         byte* d = dst.data + (usize)y * w * c;
+
+         switch (c) {
+         case 1:  downsample_row<1>(r0, r1, d, w, src.width); break;
+         case 2:  downsample_row<2>(r0, r1, d, w, src.width); break;
+         case 3:  downsample_row<3>(r0, r1, d, w, src.width); break;
+         default: downsample_row<4>(r0, r1, d, w, src.width); break;
+         }
+      }
+
+      return dst;
+   }
+
+   // Every level of the mip chain, from the full image down to 1x1.
+   std::vector<image> build_mip_chain(image base)
+   {
+      std::vector<image> levels;
+      levels.push_back(std::move(base));
+
+      while (levels.back().width > 1 || levels.back().height > 1)
+         levels.push_back(downsample(levels.back()));
+
+      return levels;
+   }
 }
\ No newline at end of file
@@ -23,6 +23,10 @@ import :types;
 import :glfw;
 import :vector;
 
+import <array>;
+import <atomic>;
+import <bitset>;
+
 export namespace tornasol {
     
     void pull_events() { 
@@ -49,72 +53,232 @@ export namespace tornasol {
     using cursor_mode    = glfw::cursor_mode;
     using cursor_standar = glfw::cursor_standar;
 
+    constexpr usize key_count    = (usize)key::menu + 1;
+    constexpr usize button_count = (usize)mouse_button::button_8 + 1;
+
+    // Single producer, single consumer ring. The window callbacks push,
+    // whoever builds the input snapshot pops, no locks on either side.
+    template <typename T, usize N>
+    class spsc_queue {
+    private:
+        static_assert((N & (N - 1)) == 0, "capacity must be a power of two");
+
+        std::array<T, N> items;
+        alignas(64) std::atomic<usize> head; // next to pop
+        alignas(64) std::atomic<usize> tail; // next to push
+
+    public:
+        spsc_queue() 
+            : head(0), tail(0) {}
+
+        // non-copyable
+        spsc_queue(const spsc_queue&) = delete;
+        spsc_queue& operator=(const spsc_queue&) = delete;
+
+        // false when full, the item is dropped
+        bool push(const T& item)
+        {
+            usize t = tail.load(std::memory_order_relaxed);
+            if (t - head.load(std::memory_order_acquire) == N)
+                return false;
+
+            items[t & (N - 1)] = item;
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool pop(T& item)
+        {
+            usize h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire))
+                return false;
+
+            item = items[h & (N - 1)];
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool empty() const {
+            return head.load() == tail.load();
+        }
+    };
+
+    enum class input_event_type : u8
+    {
+        cursor,
+        button,
+        key,
+        scroll
+    };
+
+    struct input_event {
+        input_event_type type;
+        glfw::input_action action;
+        i32 code;   // key or mouse button
+        vec2<> pos; // cursor position or scroll offset
+        f64 time;
+    };
+
+    using input_queue = spsc_queue<input_event, 1024>;
+
+    // Everything widgets need to know about the input of one frame, 
+    // plain memory and never changed after it is built.
+    struct input_state {
+        f64 time = 0.0;
+        f64 delta = 0.0;
+        vec2<> cursor = { 0.0f, 0.0f };
+        vec2<> cursor_delta = { 0.0f, 0.0f };
+        vec2<> scroll = { 0.0f, 0.0f };
+        std::bitset<key_count> keys_down;
+        std::bitset<key_count> keys_pressed;
+        std::bitset<key_count> keys_released;
+        std::bitset<button_count> buttons_down;
+        std::bitset<button_count> buttons_pressed;
+        std::bitset<button_count> buttons_released;
+    };
+
     class input {
     private:
         glfw::window_handle handle;
-        f32 last_frame;
-        f32 curr_frame;
-        f32 delta;
+        input_queue& queue;
+        input_state state;
 
     public:
-        input(glfw::window_handle handle) 
-            : handle(handle), 
-              last_frame(0.0f),
-              curr_frame(0.0f),
-              delta(0.0f) {}
+        input(glfw::window_handle handle, input_queue& queue) 
+            : handle(handle), queue(queue)
+        {
+            f64 x, y;
+            glfw::get_cursor_pos(handle, &x, &y);
+            state.cursor = vec2<>((f32)x, (f32)y);
+            state.time = get_time();
+        }
 
         glfw::window_handle get_handle() {
             return handle;
         }
 
+        // Drains the queued window events into a new snapshot, call it 
+        // once per frame after the events were pulled.
         void update() 
         {
-            curr_frame = get_time();
-            delta = curr_frame - last_frame;
-            last_frame = curr_frame;
+            input_state next = state;
+            next.time = get_time();
+            next.delta = next.time - state.time;
+            next.cursor_delta = {};
+            next.scroll = {};
+            next.keys_pressed.reset();
+            next.keys_released.reset();
+            next.buttons_pressed.reset();
+            next.buttons_released.reset();
+
+            input_event e;
+            while (queue.pop(e))
+                apply(next, e);
+
+            next.cursor_delta = next.cursor - state.cursor;
+            state = next;
+        }
+
+        const input_state& get_state() const {
+            return state;
         }
 
-        f32 get_time() const {
+        f64 get_time() const {
             return glfw::get_time();
         }
 
         f32 get_delta() const {
-            return delta;
+            return (f32)state.delta;
         }
 
         f32 get_last_frame() const {
-            return last_frame;
+            return (f32)(state.time - state.delta);
         }
 
         f32 get_curr_frame() const {
-            return curr_frame;
+            return (f32)state.time;
         }
         
+        // held during this frame
+        bool key_down(key key) const {
+            return test(state.keys_down, (i32)key);
+        }
+
+        // went down this frame
         bool key_pressed(key key) const {
-            return glfw::get_key(handle, key) == key_action::press;
+            return test(state.keys_pressed, (i32)key);
         }
 
+        // went up this frame
         bool key_released(key key) const {
-            return glfw::get_key(handle, key) == key_action::release;
+            return test(state.keys_released, (i32)key);
         }
 
-        bool mouse_pressed(mouse_button button) const
-        {
-            return glfw::get_mouse_button(handle, button) 
-                == mouse_action::press;
+        bool mouse_down(mouse_button button) const {
+            return test(state.buttons_down, (i32)button);
+        }
+
+        bool mouse_pressed(mouse_button button) const {
+            return test(state.buttons_pressed, (i32)button);
+        }
+
+        bool mouse_released(mouse_button button) const {
+            return test(state.buttons_released, (i32)button);
+        }
+
+        vec2<> cursor_pos() const {
+            return state.cursor;
+        }
+
+        vec2<> cursor_delta() const {
+            return state.cursor_delta;
+        }
+
+        vec2<> scroll() const {
+            return state.scroll;
         }
 
-        bool mouse_released(mouse_button button) const
+    private:
+        template <usize N>
+        static bool test(const std::bitset<N>& bits, i32 i) {
+            return i >= 0 && i < (i32)N && bits[i];
+        }
+
+        template <usize N>
+        static void set(std::bitset<N>& down, std::bitset<N>& pressed, 
+            std::bitset<N>& released, i32 i, glfw::input_action action)
         {
-            return glfw::get_mouse_button(handle, button) 
-                == mouse_action::release;
+            if (i < 0 || i >= (i32)N)
+                return;
+
+            if (action == glfw::input_action::press) {
+                pressed[i] = !down[i];
+                down[i] = true;
+            }
+            else if (action == glfw::input_action::release) {
+                released[i] = down[i];
+                down[i] = false;
+            }
         }
 
-        vec2<> cursor_pos() const 
+        static void apply(input_state& s, const input_event& e)
         {
-            f64 x, y;
-            glfw::get_cursor_pos(handle, &x, &y);
-            return vec2<>((f32)x, (f32)y);
+            switch (e.type) {
+            case input_event_type::cursor:
+                s.cursor = e.pos;
+                break;
+            case input_event_type::scroll:
+                s.scroll = s.scroll + e.pos;
+                break;
+            case input_event_type::key:
+                set(s.keys_down, s.keys_pressed, s.keys_released, 
+                    e.code, e.action);
+                break;
+            case input_event_type::button:
+                set(s.buttons_down, s.buttons_pressed, s.buttons_released, 
+                    e.code, e.action);
+                break;
+            }
         }
     };
-}
\ No newline at end of file
+}
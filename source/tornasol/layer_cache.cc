@@ -0,0 +1,143 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module tornasol:layer_cache;
+
+import :color;
+import :command;
+import :framebuffer;
+import :matrix;
+import :rect;
+import :renderer;
+import :size;
+import :texture;
+import :types;
+
+import <memory>;
+import <span>;
+
+export namespace tornasol {
+
+    // Keeps the bottom layers of a frame, the ones that hardly ever change,
+    // rendered in a framebuffer. Each submit composites them with a single
+    // quad and draws the layers above as usual. The cache is redrawn when 
+    // the commands of its layers hash differently, a texture they use 
+    // finishes loading or the window resizes.
+    class layer_cache {
+    private:
+        // The renderer skips textures still loading, a cache drawn before
+        // they are ready must be redrawn once they are.
+        static bool is_ready(const command_list::entry& e)
+        {
+            switch (e.type) {
+            case command_type::draw_sprite:
+                return ((draw_sprite_command*)e.data)->tex->is_ready();
+            case command_type::draw_text:
+                return ((draw_text_command*)e.data)->atlas->is_ready();
+            default:
+                return true;
+            }
+        }
+
+        i32 top; // highest cached layer
+        unique<framebuffer> target;
+        u64 hash;
+        bool valid;
+        u64 redraws;
+
+    public:
+        layer_cache(i32 top)
+            : top(top), hash(0), valid(false), redraws(0) {}
+
+        // non-copyable
+        layer_cache(const layer_cache&) = delete;
+        layer_cache& operator=(const layer_cache&) = delete;
+
+        i32 get_top() const {
+            return top;
+        }
+
+        // times the cached layers were drawn again
+        u64 get_redraws() const {
+            return redraws;
+        }
+
+        void invalidate() {
+            valid = false;
+        }
+
+        void submit(renderer& renderer, command_queue& queue, 
+            const command_list& frame, color bg)
+        {
+            const command_list* lists[] = { &frame };
+            submit(renderer, queue, lists, bg);
+        }
+
+        void submit(renderer& renderer, command_queue& queue, 
+            std::span<const command_list* const> lists, color bg)
+        {
+            auto cached = [this](const command_list::entry& e) {
+                return command_key::get_target(e.key) == 0
+                    && e.type != command_type::bind_target
+                    && command_key::get_layer(e.key) <= top;
+            };
+
+            u64 h = command_list::empty_hash;
+            for (const command_list* l : lists)
+                for (auto& e : l->get_entries())
+                    if (cached(e))
+                        h = command_list::mix(command_list::mix(h, e.hash), 
+                            is_ready(e));
+
+            size2<i32> size = renderer.get_render_size();
+            if (size.w <= 0 || size.h <= 0)
+                return;
+
+            if (!target || target->get_size() != size) {
+                target = std::make_unique<framebuffer>(size);
+                valid = false;
+            }
+
+            if (!valid || h != hash)
+            {
+                renderer.bind_target(target.get());
+                renderer.clear(bg);
+                queue.submit(renderer, lists, cached);
+
+                hash = h;
+                valid = true;
+                ++redraws;
+            }
+
+            // the cache is opaque, blending it would only let the clear 
+            // color bleed through at translucent edges
+            renderer.set_blending(false);
+            size2<i32> design = renderer.get_camera().get_design();
+            renderer.render(*target->get_color(), 
+                rect<>(0.0f, 0.0f, (f32)design.w, (f32)design.h), mat4<>(1.0f));
+            renderer.set_blending(true);
+
+            queue.submit(renderer, lists, 
+                [&cached](const command_list::entry& e) { 
+                    return !cached(e); 
+                });
+        }
+    };
+}
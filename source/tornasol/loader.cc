@@ -0,0 +1,237 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module tornasol:loader;
+
+import :buffer;
+import :image;
+import :texture;
+import :types;
+
+import <chrono>;
+import <condition_variable>;
+import <deque>;
+import <exception>;
+import <filesystem>;
+import <iterator>;
+import <memory>;
+import <mutex>;
+import <span>;
+import <stop_token>;
+import <thread>;
+import <utility>;
+import <vector>;
+
+export namespace tornasol {
+
+    // Streams textures in the background. Images are decoded and their mip
+    // chains built by a pool of worker threads, then uploaded to the gpu on
+    // the render thread a few levels per frame, through a pair of pixel 
+    // buffers.
+    class texture_loader {
+    private:
+        struct request {
+            fs::path path;
+            std::span<const byte> encoded; // decoded instead of path if set
+            image pixels; // already decoded, used as is if set
+            shared<texture> tex;
+        };
+
+        struct decoded {
+            std::vector<image> levels;
+            shared<texture> tex;
+            bool opaque; // alpha analysed on the worker too
+        };
+
+        std::mutex mutex;
+        std::condition_variable_any cond;
+        std::deque<request> requests;
+        std::deque<decoded> done;
+        std::exception_ptr error;
+        
+        // render thread only
+        pixel_buffer pbos[2];
+        usize next_pbo;
+        usize pending;
+        decoded current; // being uploaded
+        u32 next_level;
+
+        // last member, workers must be joined before anything else dies
+        std::vector<std::jthread> workers;
+
+    public:
+        texture_loader(u32 threads = default_threads())
+            : next_pbo(0), pending(0), next_level(0)
+        {
+            for (u32 i = 0; i < threads; ++i)
+                workers.emplace_back([this](std::stop_token stop) { 
+                    work(stop); 
+                });
+        }
+
+        // non-copyable
+        texture_loader(const texture_loader&) = delete;
+        texture_loader& operator=(const texture_loader&) = delete;
+
+        static u32 default_threads() 
+        {
+            u32 n = std::thread::hardware_concurrency();
+            return n > 1 ? n - 1 : 1;
+        }
+
+        // Returns immediately with a texture that becomes ready once the 
+        // image has been decoded and uploaded by update().
+        shared<texture> load(fs::path path)
+        {
+            return push({ std::move(path), {}, {}, nullptr });
+        }
+
+        // Same as load(path) for an image already in memory. The bytes must
+        // outlive the request, e.g. point into a mapped asset_pack.
+        shared<texture> load(std::span<const byte> encoded) {
+            return push({ {}, encoded, {}, nullptr });
+        }
+
+        // Uploads pixels generated at runtime, only the mip chain is built
+        // in the background.
+        shared<texture> load(image pixels) {
+            return push({ {}, {}, std::move(pixels), nullptr });
+        }
+
+        // Uploads mip levels of decoded images until the time budget (in 
+        // seconds) is spent. At least one level is uploaded per call so 
+        // loading always makes progress. Must be called from the thread 
+        // owning the gl context.
+        void update(f64 budget)
+        {
+            using clock = std::chrono::steady_clock;
+            const auto start = clock::now();
+
+            while (true)
+            {
+                if (!current.tex)
+                {
+                    std::scoped_lock lock(mutex);
+
+                    if (error)
+                        std::rethrow_exception(std::exchange(error, nullptr));
+
+                    if (done.empty())
+                        return;
+
+                    current = std::move(done.front());
+                    done.pop_front();
+                    next_level = 0;
+                }
+
+                upload_level();
+
+                std::chrono::duration<f64> elapsed = clock::now() - start;
+                if (elapsed.count() >= budget)
+                    return;
+            }
+        }
+
+        bool is_busy() const {
+            return pending > 0;
+        }
+
+        usize get_pending() const {
+            return pending;
+        }
+
+    private:
+        shared<texture> push(request req)
+        {
+            auto tex = std::make_shared<texture>();
+            req.tex = tex;
+            {
+                std::scoped_lock lock(mutex);
+                requests.push_back(std::move(req));
+            }
+            cond.notify_one();
+            ++pending;
+            return tex;
+        }
+
+        void upload_level()
+        {
+            texture& tex = *current.tex;
+            pixel_buffer& pbo = pbos[next_pbo];
+            next_pbo = (next_pbo + 1) % std::size(pbos);
+
+            tex.bind();
+
+            if (next_level == 0)
+            {
+                const image& base = current.levels[0];
+                tex.set_wrap(texture_wrap::repeat, texture_wrap::repeat);
+                tex.set_filter(texture_filter::linear_mipmap_linear, 
+                    texture_filter::linear);
+                tex.allocate_levels({ base.width, base.height }, 
+                    (u32)current.levels.size(), base.channels);
+                tex.set_opaque(current.opaque);
+            }
+
+            tex.load_level(next_level, current.levels[next_level], pbo);
+            current.levels[next_level] = image(); // copied out already
+
+            if (++next_level == current.levels.size()) {
+                current = {};
+                --pending;
+            }
+        }
+
+        void work(std::stop_token stop)
+        {
+            while (true)
+            {
+                request req;
+                {
+                    std::unique_lock lock(mutex);
+
+                    if (!cond.wait(lock, stop, [this] { 
+                        return !requests.empty(); 
+                    }))
+                        return;
+
+                    req = std::move(requests.front());
+                    requests.pop_front();
+                }
+
+                try {
+                    image img = req.pixels.data ? std::move(req.pixels)
+                        : req.encoded.empty() ? image(req.path) 
+                        : image(req.encoded);
+                    bool opaque = is_opaque(img);
+                    auto levels = build_mip_chain(std::move(img));
+                    std::scoped_lock lock(mutex);
+                    done.push_back({ std::move(levels), std::move(req.tex), 
+                        opaque });
+                }
+                catch (...) {
+                    std::scoped_lock lock(mutex);
+                    if (!error) 
+                        error = std::current_exception();
+                }
+            }
+        }
+    };
+}
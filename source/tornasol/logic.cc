@@ -0,0 +1,125 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module tornasol:logic;
+
+import :arena;
+import :types;
+
+import <atomic>;
+import <chrono>;
+import <exception>;
+import <functional>;
+import <stop_token>;
+import <thread>;
+import <utility>;
+
+export namespace tornasol {
+
+    // Runs a simulation tick at a fixed rate on its own thread, apart 
+    // from rendering. A tick that runs late is caught up right away, but
+    // after falling far behind the clock is reset instead of spiraling.
+    // The thread's frame arena is reset after every tick.
+    class logic_thread {
+    private:
+        std::chrono::duration<f64> step;
+        std::function<void(f64)> tick;
+        std::exception_ptr error;
+        std::atomic<bool> failed; // error is set
+        std::jthread thread;
+
+    public:
+        static constexpr u32 max_catch_up = 5;
+
+        logic_thread(f64 step_seconds, std::function<void(f64)> tick)
+            : step(step_seconds), tick(std::move(tick)), failed(false) {}
+
+        ~logic_thread() {
+            stop();
+        }
+
+        // non-copyable
+        logic_thread(const logic_thread&) = delete;
+        logic_thread& operator=(const logic_thread&) = delete;
+
+        f64 get_step() const {
+            return step.count();
+        }
+
+        bool is_running() const {
+            return thread.joinable();
+        }
+
+        void start()
+        {
+            stop();
+            thread = std::jthread([this](std::stop_token stop) { run(stop); });
+        }
+
+        // waits for the tick in progress
+        void stop()
+        {
+            if (!thread.joinable())
+                return;
+
+            thread.request_stop();
+            thread.join();
+        }
+
+        // Rethrows, on the calling thread, what made a tick fail. The 
+        // thread stops at the first failure.
+        void check()
+        {
+            if (!failed)
+                return;
+
+            thread.join();
+            failed = false;
+            std::rethrow_exception(std::exchange(error, nullptr));
+        }
+
+    private:
+        void run(std::stop_token stop)
+        {
+            using clock = std::chrono::steady_clock;
+            auto dt = std::chrono::duration_cast<clock::duration>(step);
+            auto next = clock::now();
+
+            try {
+                while (!stop.stop_requested())
+                {
+                    tick(step.count());
+                    get_frame_arena().reset();
+                    next += dt;
+
+                    auto now = clock::now();
+                    if (now < next)
+                        std::this_thread::sleep_until(next);
+                    else if (now - next > max_catch_up * dt)
+                        next = now;
+                }
+            }
+            catch (...) {
+                error = std::current_exception();
+                failed = true;
+            }
+        }
+    };
+}
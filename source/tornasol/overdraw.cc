@@ -0,0 +1,127 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module tornasol:overdraw;
+
+import :matrix;
+import :rect;
+import :size;
+import :types;
+
+import <algorithm>;
+import <cmath>;
+import <limits>;
+import <vector>;
+
+export namespace tornasol {
+
+    // Estimates how many pixels a frame shades, from the bounds of what is
+    // drawn, on a grid of coarse cells. Each cell remembers the nearest
+    // opaque sprite covering all of it, so parts hidden behind one are not 
+    // counted when depth testing would reject them.
+    class overdraw_meter {
+    private:
+        static constexpr i32 cell = 16; // pixels
+
+        size2<i32> size;
+        i32 cols;
+        i32 rows;
+        std::vector<f32> nearest; // per cell, of a covering opaque sprite
+        f64 shaded;
+
+    public:
+        overdraw_meter()
+            : size({ 0, 0 }), cols(0), rows(0), shaded(0.0) {}
+
+        // Forgets what covers the target, e.g. on a depth clear.
+        void clear(size2<i32> target)
+        {
+            if (target != size)
+            {
+                size = target;
+                cols = (std::max(size.w, 0) + cell - 1) / cell;
+                rows = (std::max(size.h, 0) + cell - 1) / cell;
+            }
+
+            nearest.assign((usize)cols * rows, 
+                -std::numeric_limits<f32>::infinity());
+        }
+
+        // Counts a sprite, the rect placed by model. Only an opaque sprite 
+        // that is not rotated occludes, and only with depth testing.
+        void add(const rect<>& r, const mat4<>& m, f32 depth, bool tested, 
+            bool occluder)
+        {
+            const f32 xs[] = { r.x, r.x + r.w };
+            const f32 ys[] = { r.y, r.y + r.h };
+
+            f32 x0 = std::numeric_limits<f32>::max(), y0 = x0;
+            f32 x1 = std::numeric_limits<f32>::lowest(), y1 = x1;
+            for (f32 x : xs)
+                for (f32 y : ys)
+                {
+                    f32 px = m[0][0] * x + m[1][0] * y + m[3][0];
+                    f32 py = m[0][1] * x + m[1][1] * y + m[3][1];
+                    x0 = std::min(x0, px); x1 = std::max(x1, px);
+                    y0 = std::min(y0, py); y1 = std::max(y1, py);
+                }
+
+            x0 = std::max(x0, 0.0f); x1 = std::min(x1, (f32)size.w);
+            y0 = std::max(y0, 0.0f); y1 = std::min(y1, (f32)size.h);
+            if (x0 >= x1 || y0 >= y1)
+                return;
+
+            const bool aligned = m[0][1] == 0.0f && m[1][0] == 0.0f;
+            occluder = occluder && tested && aligned;
+
+            const i32 c0 = (i32)(x0 / cell), c1 = (i32)std::ceil(x1 / cell);
+            const i32 r0 = (i32)(y0 / cell), r1 = (i32)std::ceil(y1 / cell);
+
+            for (i32 row = r0; row < std::min(r1, rows); ++row)
+                for (i32 col = c0; col < std::min(c1, cols); ++col)
+                {
+                    f32& n = nearest[(usize)row * cols + col];
+                    if (tested && depth < n)
+                        continue; // behind an opaque sprite
+
+                    const f32 cx0 = (f32)(col * cell), cx1 = cx0 + cell;
+                    const f32 cy0 = (f32)(row * cell), cy1 = cy0 + cell;
+                    const f32 w = std::min(x1, cx1) - std::max(x0, cx0);
+                    const f32 h = std::min(y1, cy1) - std::max(y0, cy0);
+                    shaded += (f64)w * h;
+
+                    // the cell is hidden behind the sprite if it covers it
+                    if (occluder && x0 <= cx0 && x1 >= cx1 
+                        && y0 <= cy0 && y1 >= cy1)
+                        n = std::max(n, depth);
+                }
+        }
+
+        // Shaded pixels per pixel of the target since the last call, 1 
+        // means each one was shaded once.
+        f64 take(size2<i32> target)
+        {
+            f64 pixels = (f64)target.w * target.h;
+            f64 result = pixels > 0.0 ? shaded / pixels : 0.0;
+            shaded = 0.0;
+            return result;
+        }
+    };
+}
@@ -0,0 +1,286 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module tornasol:pack;
+
+import :file;
+import :image;
+import :types;
+
+import <cstring>;
+import <filesystem>;
+import <fstream>;
+import <span>;
+import <stdexcept>;
+import <string>;
+import <string_view>;
+import <unordered_map>;
+import <vector>;
+
+export namespace tornasol {
+
+    // Layout of a pack file:
+    //
+    //   pack_header
+    //   pack_entry[count]
+    //   names       (utf-8, not null terminated)
+    //   data        (each blob aligned to pack_alignment)
+    //
+    // Texture blobs hold a full rgba8 mip chain, largest level first, 
+    // tightly packed and flipped for gl, so they can be uploaded straight
+    // from the mapped file. Raw blobs are files stored verbatim.
+    //
+    // Lookups hand out spans into the mapping, nothing is copied.
+
+    constexpr u32 pack_magic     = 0x4b505354; // "TSPK"
+    constexpr u32 pack_version   = 1;
+    constexpr u64 pack_alignment = 16;
+
+    enum class pack_kind : u32
+    {
+        texture = 1,
+        raw     = 2,
+    };
+
+    enum pack_flags : u32
+    {
+        pack_premultiplied = 1 << 0,
+        pack_opaque        = 1 << 1, // no translucent texel
+    };
+
+    struct pack_header 
+    {
+        u32 magic;
+        u32 version;
+        u32 count;
+        u32 reserved;
+    };
+
+    struct pack_entry 
+    {
+        u32 name_offset;
+        u32 name_len;
+        pack_kind kind;
+        u32 flags;
+        u32 width;
+        u32 height;
+        u32 levels;
+        u32 reserved;
+        f32 uv[4];       // region of the texture, (0, 0, 1, 1) if unpacked
+        u64 offset;
+        u64 size;
+    };
+
+    // Name under which an asset path is stored and looked up.
+    std::string pack_key(const fs::path& path) {
+        return path.lexically_normal().generic_string();
+    }
+
+    class pack_writer {
+    private:
+        struct item {
+            std::string name;
+            pack_entry entry;
+            std::vector<byte> data;
+        };
+
+        std::vector<item> items;
+
+    public:
+        // Levels must be rgba, see to_rgba and build_mip_chain.
+        void add_texture(const fs::path& path, 
+            const std::vector<image>& levels, bool premultiplied)
+        {
+            item it = {};
+            it.name = pack_key(path);
+            it.entry.kind = pack_kind::texture;
+            it.entry.flags = premultiplied ? pack_premultiplied : 0;
+            if (is_opaque(levels.front()))
+                it.entry.flags |= pack_opaque;
+            it.entry.width = levels.front().width;
+            it.entry.height = levels.front().height;
+            it.entry.levels = (u32)levels.size();
+            it.entry.uv[2] = 1.0f;
+            it.entry.uv[3] = 1.0f;
+
+            for (auto& level : levels) 
+            {
+                if (level.channels != 4)
+                    throw std::runtime_error("pack textures must be rgba");
+
+                it.data.insert(it.data.end(), 
+                    level.data, level.data + level.get_size());
+            }
+
+            items.push_back(std::move(it));
+        }
+
+        // Stores the file as is, to be decoded or parsed from memory.
+        void add_raw(const fs::path& path)
+        {
+            std::ifstream in(path, std::ios::binary);
+
+            if (!in)
+                throw std::runtime_error("failed to open file");
+
+            item it = {};
+            it.name = pack_key(path);
+            it.entry.kind = pack_kind::raw;
+            it.data.resize((usize)fs::file_size(path));
+            in.read((char*)it.data.data(), it.data.size());
+
+            items.push_back(std::move(it));
+        }
+
+        usize get_count() const {
+            return items.size();
+        }
+
+        void write(const fs::path& path)
+        {
+            pack_header header = {};
+            header.magic = pack_magic;
+            header.version = pack_version;
+            header.count = (u32)items.size();
+
+            std::string names;
+            for (auto& it : items) {
+                it.entry.name_offset = (u32)names.size();
+                it.entry.name_len = (u32)it.name.size();
+                names += it.name;
+            }
+
+            u64 offset = sizeof(pack_header) 
+                + sizeof(pack_entry) * items.size() + names.size();
+
+            for (auto& it : items) {
+                offset = align(offset);
+                it.entry.offset = offset;
+                it.entry.size = it.data.size();
+                offset += it.data.size();
+            }
+
+            std::ofstream out(path, std::ios::binary);
+
+            if (!out)
+                throw std::runtime_error("failed to create pack");
+
+            out.write((const char*)&header, sizeof(header));
+
+            for (auto& it : items)
+                out.write((const char*)&it.entry, sizeof(pack_entry));
+
+            out.write(names.data(), names.size());
+
+            const char zeros[pack_alignment] = {};
+            for (auto& it : items) {
+                u64 pos = (u64)out.tellp();
+                out.write(zeros, it.entry.offset - pos);
+                out.write((const char*)it.data.data(), it.data.size());
+            }
+
+            if (!out)
+                throw std::runtime_error("failed to write pack");
+        }
+
+    private:
+        static u64 align(u64 offset) {
+            return (offset + pack_alignment - 1) & ~(pack_alignment - 1);
+        }
+    };
+
+    // Read-only pack mapped into memory. Entries and blobs point straight
+    // into the mapping and stay valid for the lifetime of the pack.
+    class asset_pack {
+    private:
+        mapped_file file;
+        std::span<const pack_entry> entries;
+        std::unordered_map<std::string_view, const pack_entry*> index;
+
+    public:
+        asset_pack(const fs::path& path)
+            : file(path)
+        {
+            std::span<const byte> bytes = file.get_bytes();
+
+            if (bytes.size() < sizeof(pack_header))
+                throw std::runtime_error("invalid pack");
+
+            pack_header header;
+            std::memcpy(&header, bytes.data(), sizeof(header));
+
+            if (header.magic != pack_magic || header.version != pack_version)
+                throw std::runtime_error("invalid pack");
+
+            const usize table = sizeof(pack_header) 
+                + sizeof(pack_entry) * header.count;
+
+            if (bytes.size() < table)
+                throw std::runtime_error("invalid pack");
+
+            entries = { 
+                (const pack_entry*)(bytes.data() + sizeof(pack_header)), 
+                header.count 
+            };
+
+            for (auto& e : entries) 
+            {
+                if (table + e.name_offset + e.name_len > bytes.size() ||
+                    e.offset + e.size > bytes.size())
+                    throw std::runtime_error("invalid pack");
+
+                std::string_view name(
+                    (const char*)bytes.data() + table + e.name_offset, 
+                    e.name_len);
+
+                index.emplace(name, &e);
+            }
+        }
+
+        // non-copyable
+        asset_pack(const asset_pack&) = delete;
+        asset_pack& operator=(const asset_pack&) = delete;
+
+        const pack_entry* find(std::string_view name) const
+        {
+            auto it = index.find(name);
+            return it != index.end() ? it->second : nullptr;
+        }
+
+        std::span<const byte> get_data(const pack_entry& e) const {
+            return file.get_bytes().subspan(e.offset, e.size);
+        }
+
+        // Contents of a raw entry, empty if there is none with that name.
+        std::span<const byte> get(std::string_view name) const
+        {
+            const pack_entry* e = find(name);
+
+            if (!e || e->kind != pack_kind::raw)
+                return {};
+
+            return get_data(*e);
+        }
+
+        std::span<const pack_entry> get_entries() const {
+            return entries;
+        }
+    };
+}
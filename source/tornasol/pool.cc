@@ -0,0 +1,140 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module tornasol:pool;
+
+import :types;
+
+import <utility>;
+import <vector>;
+
+export namespace tornasol {
+
+    struct pool_handle {
+        u32 index = ~0u;
+        u32 gen = 0;
+
+        bool operator == (const pool_handle& other) const = default;
+    };
+
+    constexpr pool_handle null_handle = {};
+
+    // Keeps objects alive after they are released and hands them out 
+    // again, so a steady flow of short-lived objects allocates only until
+    // the pool is as large as the busiest moment needed. Handles carry a
+    // generation, a stale one finds nothing instead of the object's next 
+    // user. Objects may move in memory when the pool grows, handles don't.
+    template <typename T>
+    class pool {
+    private:
+        std::vector<T>   items;
+        std::vector<u32> gens;
+        std::vector<u8>  used;
+        std::vector<u32> free;
+        usize live;
+
+    public:
+        pool(usize capacity = 0)
+            : live(0)
+        {
+            reserve(capacity);
+        }
+
+        // non-copyable
+        pool(const pool&) = delete;
+        pool& operator=(const pool&) = delete;
+
+        // Makes room for that many objects without constructing any.
+        void reserve(usize capacity)
+        {
+            items.reserve(capacity);
+            gens.reserve(capacity);
+            used.reserve(capacity);
+            free.reserve(capacity);
+        }
+
+        // A released object as it was left, or a new one made from the 
+        // arguments when none is free. The caller resets what it needs.
+        template <typename... Args>
+        pool_handle acquire(Args&&... args)
+        {
+            u32 i;
+            if (!free.empty()) {
+                i = free.back();
+                free.pop_back();
+            }
+            else {
+                i = (u32)items.size();
+                items.emplace_back(std::forward<Args>(args)...);
+                gens.push_back(0);
+                used.push_back(0);
+                free.reserve(items.capacity());
+            }
+
+            used[i] = 1;
+            ++live;
+            return { i, gens[i] };
+        }
+
+        // Takes the object back, the handle and its copies go stale.
+        void release(pool_handle h)
+        {
+            if (!is_alive(h))
+                return;
+
+            used[h.index] = 0;
+            ++gens[h.index];
+            free.push_back(h.index);
+            --live;
+        }
+
+        bool is_alive(pool_handle h) const {
+            return h.index < items.size() && used[h.index] 
+                && gens[h.index] == h.gen;
+        }
+
+        // nullptr for a stale handle
+        T* find(pool_handle h) {
+            return is_alive(h) ? &items[h.index] : nullptr;
+        }
+
+        const T* find(pool_handle h) const {
+            return is_alive(h) ? &items[h.index] : nullptr;
+        }
+
+        T& operator[](pool_handle h) {
+            return items[h.index];
+        }
+
+        const T& operator[](pool_handle h) const {
+            return items[h.index];
+        }
+
+        // objects handed out
+        usize get_size() const {
+            return live;
+        }
+
+        // objects ever constructed, handed out or free
+        usize get_capacity() const {
+            return items.size();
+        }
+    };
+}
@@ -0,0 +1,339 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module tornasol:profiler;
+
+import :gl;
+import :types;
+
+import <atomic>;
+import <chrono>;
+import <filesystem>;
+import <fstream>;
+import <iomanip>;
+import <memory>;
+import <mutex>;
+import <stdexcept>;
+import <string_view>;
+import <thread>;
+import <unordered_map>;
+import <vector>;
+
+export namespace tornasol {
+
+    // nanoseconds on a monotonic clock
+    u64 profiler_now() 
+    {
+        return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    struct profile_event 
+    {
+        const char* name; // static string, e.g. "game::update"
+        u64 begin;
+        u64 end;
+    };
+
+    struct scope_stats 
+    {
+        const char* name;
+        u64 total;  // ns spent in the scope during the frame
+        u32 calls;
+    };
+
+    // Fixed size ring of events written by a single thread. Readers see
+    // the last `capacity` events; the oldest ones may be overwritten while
+    // being read, which is acceptable for profiling.
+    class profile_buffer {
+    public:
+        static constexpr u64 capacity = 4096;
+
+    private:
+        std::unique_ptr<profile_event[]> events;
+        std::atomic<u64> head;
+        u64 read;  // aggregation cursor, profiler thread only
+        u32 tid;
+
+        friend class profiler;
+
+    public:
+        profile_buffer(u32 tid)
+            : events(new profile_event[capacity]), head(0), read(0), 
+              tid(tid) {}
+
+        void push(const profile_event& e)
+        {
+            u64 h = head.load(std::memory_order_relaxed);
+            events[h % capacity] = e;
+            head.store(h + 1, std::memory_order_release);
+        }
+    };
+
+    // Collects cpu scopes from any thread and gpu timings from the render
+    // thread, aggregates them per frame and exports chrome://tracing json.
+    class profiler {
+    private:
+        static inline std::atomic<u64> next_id = 1;
+
+        const u64 id;
+        const u64 start;
+        std::mutex mutex;
+        std::vector<unique<profile_buffer>> buffers;
+        profile_buffer gpu;
+        std::vector<scope_stats> frame;
+        u64 frame_begin;
+        u64 frame_time;
+
+    public:
+        profiler()
+            : id(next_id++), start(profiler_now()), gpu(0), 
+              frame_begin(start), frame_time(0) {}
+
+        // non-copyable
+        profiler(const profiler&) = delete;
+        profiler& operator=(const profiler&) = delete;
+
+        // buffer owned by the calling thread
+        profile_buffer& local()
+        {
+            thread_local u64 owner = 0;
+            thread_local profile_buffer* buffer = nullptr;
+
+            if (owner != id) 
+            {
+                std::scoped_lock lock(mutex);
+                buffers.push_back(
+                    std::make_unique<profile_buffer>((u32)buffers.size() + 1));
+                buffer = buffers.back().get();
+                owner = id;
+            }
+
+            return *buffer;
+        }
+
+        void record(const char* name, u64 begin, u64 end) {
+            local().push({ name, begin, end });
+        }
+
+        void record_gpu(const char* name, u64 begin, u64 elapsed) {
+            gpu.push({ name, begin, begin + elapsed });
+        }
+
+        // Aggregates everything recorded since the previous call. Call once
+        // per frame, after presenting.
+        void end_frame()
+        {
+            frame.clear();
+
+            std::scoped_lock lock(mutex);
+
+            for (auto& b : buffers)
+                aggregate(*b);
+
+            aggregate(gpu);
+
+            u64 now = profiler_now();
+            frame_time = now - frame_begin;
+            frame_begin = now;
+        }
+
+        // per scope totals of the last completed frame
+        const std::vector<scope_stats>& get_frame() const {
+            return frame;
+        }
+
+        u64 get_frame_time() const {
+            return frame_time;
+        }
+
+        void write_chrome_trace(const fs::path& path)
+        {
+            std::ofstream out(path);
+
+            if (!out)
+                throw std::runtime_error("failed to create trace");
+
+            // microseconds with nanosecond digits, never in exponent form
+            out << std::fixed << std::setprecision(3);
+            out << "{\"traceEvents\":[\n";
+            bool first = true;
+
+            std::scoped_lock lock(mutex);
+
+            for (auto& b : buffers)
+                write_events(out, *b, first);
+
+            write_events(out, gpu, first);
+            out << "\n]}\n";
+        }
+
+    private:
+        void aggregate(profile_buffer& b)
+        {
+            u64 head = b.head.load(std::memory_order_acquire);
+
+            if (head - b.read > profile_buffer::capacity)
+                b.read = head - profile_buffer::capacity;
+
+            for (; b.read < head; ++b.read)
+            {
+                const profile_event& e = b.events[b.read % b.capacity];
+                scope_stats* s = nullptr;
+
+                for (auto& f : frame)
+                    if (f.name == e.name)
+                        s = &f;
+
+                if (!s)
+                    s = &frame.emplace_back(scope_stats{ e.name, 0, 0 });
+
+                s->total += e.end - e.begin;
+                s->calls += 1;
+            }
+        }
+
+        void write_events(std::ofstream& out, profile_buffer& b, bool& first)
+        {
+            u64 head = b.head.load(std::memory_order_acquire);
+            u64 tail = head > b.capacity ? head - b.capacity : 0;
+
+            for (u64 i = tail; i < head; ++i)
+            {
+                const profile_event& e = b.events[i % b.capacity];
+
+                out << (first ? "" : ",\n")
+                    << "{\"name\":\"" << e.name << "\",\"ph\":\"X\""
+                    << ",\"ts\":" << (e.begin - start) / 1000.0
+                    << ",\"dur\":" << (e.end - e.begin) / 1000.0
+                    << ",\"pid\":0,\"tid\":" << b.tid << "}";
+
+                first = false;
+            }
+        }
+    };
+
+    // Times the enclosing block on the calling thread.
+    class profile_scope {
+    private:
+        profiler& prof;
+        const char* name;
+        u64 begin;
+
+    public:
+        profile_scope(profiler& prof, const char* name)
+            : prof(prof), name(name), begin(profiler_now()) {}
+
+        ~profile_scope() {
+            prof.record(name, begin, profiler_now());
+        }
+
+        profile_scope(const profile_scope&) = delete;
+        profile_scope& operator=(const profile_scope&) = delete;
+    };
+
+    // Gpu time of a render pass, measured with GL_TIME_ELAPSED queries. 
+    // Results are read back a few frames later so the cpu never waits for
+    // them. Only one gpu timer can be running at a time (no nesting).
+    class gpu_timer {
+    private:
+        static constexpr u32 latency = 4;
+
+        profiler& prof;
+        const char* name;
+        u32 queries[latency];
+        u64 begins[latency];
+        bool used[latency];
+        u32 curr;
+
+    public:
+        gpu_timer(profiler& prof, const char* name)
+            : prof(prof), name(name), begins(), used(), curr(0)
+        {
+            for (auto& q : queries)
+                q = gl::gen_query();
+        }
+
+        ~gpu_timer() 
+        {
+            for (auto& q : queries)
+                gl::delete_query(q);
+        }
+
+        gpu_timer(const gpu_timer&) = delete;
+        gpu_timer& operator=(const gpu_timer&) = delete;
+
+        void begin()
+        {
+            collect(curr);
+            begins[curr] = profiler_now();
+            gl::begin_query(gl::time_elapsed, queries[curr]);
+        }
+
+        void end()
+        {
+            gl::end_query(gl::time_elapsed);
+            used[curr] = true;
+            curr = (curr + 1) % latency;
+        }
+
+    private:
+        void collect(u32 slot)
+        {
+            if (!used[slot])
+                return;
+
+            u32 available = 0;
+            gl::get_query_object_uiv(queries[slot], gl::query_available, 
+                &available);
+
+            used[slot] = false;
+
+            if (!available)
+                return; // dropped, the slot is about to be reused
+
+            u64 elapsed = 0;
+            gl::get_query_object_ui64v(queries[slot], gl::query_result, 
+                &elapsed);
+
+            prof.record_gpu(name, begins[slot], elapsed);
+        }
+    };
+
+    // Runs a gpu_timer for the enclosing block.
+    class gpu_scope {
+    private:
+        gpu_timer& timer;
+
+    public:
+        gpu_scope(gpu_timer& timer)
+            : timer(timer) 
+        {
+            timer.begin();
+        }
+
+        ~gpu_scope() {
+            timer.end();
+        }
+
+        gpu_scope(const gpu_scope&) = delete;
+        gpu_scope& operator=(const gpu_scope&) = delete;
+    };
+}
@@ -0,0 +1,498 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module tornasol:registry;
+
+import :arena;
+import :command;
+import :matrix;
+import :rect;
+import :renderer;
+import :size;
+import :spatial;
+import :texture;
+import :transform;
+import :types;
+import :vector;
+
+import <algorithm>;
+import <memory>;
+import <memory_resource>;
+import <numeric>;
+import <utility>;
+import <vector>;
+
+export namespace tornasol {
+
+    struct entity_id {
+        u32 index = ~0u;
+        u32 gen = 0;
+
+        bool operator == (const entity_id& other) const = default;
+    };
+
+    constexpr entity_id null_entity = {};
+
+    enum component : u32
+    {
+        component_transform = 1 << 0,
+        component_sprite    = 1 << 1,
+        component_hitbox    = 1 << 2, // needs a sprite, picks its rect
+        component_state     = 1 << 3
+    };
+
+    struct sprite {
+        shared<ts::texture> texture;
+        i32 layer = 0;
+        u16 depth = 0; // orders overlapping sprites of a layer
+        bool visible = true;
+    };
+
+    // Entities are slots in a set of parallel component arrays, systems
+    // walk each array front to back instead of chasing objects. Ids carry
+    // a generation so a stale id never reaches a reused slot.
+    //
+    // Transforms are relative to the entity's parent, if it has one. The
+    // world matrices are cached and only recomputed for entities whose 
+    // transform was touched, or whose ancestor's was. Slots are visited in
+    // a flat order sorted by depth, parents before children, rebuilt only
+    // when the hierarchy changes.
+    class registry {
+    private:
+        static constexpr u32 no_parent = ~0u;
+
+        std::vector<u32> masks;
+        std::vector<u32> gens;
+        std::vector<u32> free;
+
+        // components, indexed by slot
+        std::vector<transform>   transforms;
+        std::vector<mat4<>>      models; // world, written by update()
+        std::vector<sprite>      sprites;
+        std::vector<pick_handle> hitboxes;
+        std::vector<u32>         states;
+
+        // hierarchy, indexed by slot
+        std::vector<u32> parents;
+        std::vector<u8>  dirty; // transform touched since the last update
+        std::vector<u8>  moved; // world recomputed by the last update
+        std::vector<u32> order; // slots, parents first
+        bool order_dirty;
+
+        mat4<> view; // placed in front of every root
+        bool view_dirty;
+        spatial_index index;
+        std::vector<u32> pick_owner; // pick id to slot
+        command_list frame;  // scratch for render()
+        command_queue queue;
+
+    public:
+        registry()
+            : order_dirty(false), view(1.0f), view_dirty(false) {}
+
+        // non-copyable
+        registry(const registry&) = delete;
+        registry& operator=(const registry&) = delete;
+
+        entity_id create(u32 components = component_transform)
+        {
+            u32 slot;
+            if (!free.empty()) {
+                slot = free.back();
+                free.pop_back();
+            }
+            else {
+                slot = (u32)masks.size();
+                masks.push_back(0);
+                gens.push_back(0);
+                transforms.emplace_back();
+                models.emplace_back(1.0f);
+                sprites.emplace_back();
+                hitboxes.emplace_back();
+                states.push_back(0);
+                parents.push_back(no_parent);
+                dirty.push_back(1);
+                moved.push_back(0);
+                order_dirty = true;
+            }
+
+            dirty[slot] = 1;
+
+            entity_id id = { slot, gens[slot] };
+            add(id, components);
+            return id;
+        }
+
+        void destroy(entity_id id)
+        {
+            if (!is_alive(id))
+                return;
+
+            u32 i = id.index;
+
+            // children are left at the root, where they are, while the
+            // chain above them is still there
+            for (u32 j = 0; j < (u32)parents.size(); ++j)
+                if (parents[j] == i) {
+                    bake_root(j);
+                    parents[j] = no_parent;
+                    dirty[j] = 1;
+                    order_dirty = true;
+                }
+
+            if (parents[i] != no_parent)
+                order_dirty = true;
+
+            parents[i] = no_parent;
+            masks[i] = 0;
+            transforms[i] = {};
+            sprites[i] = {};
+            hitboxes[i] = {};
+            states[i] = 0;
+            ++gens[i];
+
+            free.push_back(i);
+        }
+
+        bool is_alive(entity_id id) const 
+        {
+            return id.index < masks.size() && gens[id.index] == id.gen 
+                && masks[id.index] != 0;
+        }
+
+        bool has(entity_id id, u32 components) const {
+            return is_alive(id) && (masks[id.index] & components) == components;
+        }
+
+        // A hitbox is picked on the layer its sprite has when added.
+        void add(entity_id id, u32 components)
+        {
+            u32 i = id.index;
+            u32 added = components & ~masks[i];
+            masks[i] |= components;
+
+            if (added & component_hitbox) 
+            {
+                hitboxes[i] = pick_handle(index, draw_order(i));
+
+                pick_id pick = hitboxes[i].get_id();
+                if (pick >= pick_owner.size())
+                    pick_owner.resize(pick + 1);
+                pick_owner[pick] = i;
+            }
+        }
+
+        usize get_size() const {
+            return masks.size() - free.size();
+        }
+
+        // Marks the transform dirty, taking it counts as changing it.
+        transform& get_transform(entity_id id) 
+        {
+            dirty[id.index] = 1;
+            return transforms[id.index];
+        }
+
+        const transform& get_transform(entity_id id) const {
+            return transforms[id.index];
+        }
+
+        // world matrix as of the last update, view included
+        const mat4<>& get_model(entity_id id) const {
+            return models[id.index];
+        }
+
+        // Moves an entity under another, or back to the root with 
+        // null_entity. Its transform becomes relative to the parent, which
+        // must have a transform too and must not be one of its children.
+        void set_parent(entity_id child, entity_id parent)
+        {
+            u32 p = is_alive(parent) ? parent.index : no_parent;
+            if (!is_alive(child) || parents[child.index] == p)
+                return;
+
+            parents[child.index] = p;
+            dirty[child.index] = 1;
+            order_dirty = true;
+        }
+
+        entity_id get_parent(entity_id id) const
+        {
+            u32 p = parents[id.index];
+            return p == no_parent ? null_entity : entity_id{ p, gens[p] };
+        }
+
+        // Maps the entity's space to the registry's, before the view. 
+        // Composed from the transforms, so it is current before update().
+        mat4<> get_root_mat(entity_id id) const
+        {
+            mat4<> m(1.0f);
+            for (u32 i = id.index; i != no_parent; i = parents[i])
+                m = transforms[i].get_mat() * m;
+            return m;
+        }
+
+        // A point of the registry's space, before the view, in the space
+        // of the entity's children. 
+        vec3<> to_local(entity_id id, vec3<> point) const
+        {
+            // inverse of the 2d affine part
+            mat4<> m = get_root_mat(id);
+            f32 det = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+            if (det == 0.0f)
+                return point;
+
+            f32 x = point.x - m[3][0];
+            f32 y = point.y - m[3][1];
+            return { 
+                ( m[1][1] * x - m[1][0] * y) / det,
+                (-m[0][1] * x + m[0][0] * y) / det,
+                point.z - m[3][2]
+            };
+        }
+
+        sprite& get_sprite(entity_id id) {
+            return sprites[id.index];
+        }
+
+        u32& get_state(entity_id id) {
+            return states[id.index];
+        }
+
+        const mat4<>& get_view() const {
+            return view;
+        }
+
+        // Places the whole registry, e.g. one of several tables in a 
+        // window. Models and hitboxes include it from the next update.
+        void set_view(const mat4<>& value) 
+        {
+            view = value;
+            view_dirty = true;
+        }
+
+        // transform system, then hitbox system
+        void update()
+        {
+            const usize n = masks.size();
+
+            if (order_dirty)
+                sort_order();
+
+            // parents come first, their moved flag is final by the time 
+            // their children are visited
+            for (u32 i : order)
+            {
+                moved[i] = 0;
+                if (!(masks[i] & component_transform))
+                    continue;
+
+                u32 p = parents[i];
+                bool parent_moved = p == no_parent ? view_dirty : moved[p];
+                if (!dirty[i] && !parent_moved)
+                    continue;
+
+                const mat4<>& base = p == no_parent ? view : models[p];
+                models[i] = base * transforms[i].get_mat();
+                moved[i] = 1;
+                dirty[i] = 0;
+            }
+
+            view_dirty = false;
+
+            for (usize i = 0; i < n; ++i)
+            {
+                if (!(masks[i] & component_hitbox))
+                    continue;
+
+                // hidden sprites can't be picked
+                const sprite& s = sprites[i];
+                size2<i32> size = s.visible && s.texture 
+                    ? s.texture->get_size() : size2<i32>{};
+                hitboxes[i].update({ (f32)size.w, (f32)size.h }, models[i],
+                    draw_order(i));
+            }
+        }
+
+        // Sprite system, records a draw for every visible sprite. The list
+        // keeps its own references, so it can be submitted after the
+        // registry moved on, from another thread.
+        void record(command_list& out, u8 target = 0) const
+        {
+            for (u32 i = 0; i < (u32)masks.size(); ++i)
+            {
+                const sprite& s = sprites[i];
+                if (!(masks[i] & component_sprite) || !s.visible || !s.texture)
+                    continue;
+
+                size2<i32> size = s.texture->get_size();
+                out.draw_sprite(target, s.layer, s.depth, s.texture, 
+                    { (f32)size.w, (f32)size.h }, models[i]);
+            }
+        }
+
+        void render(renderer& renderer)
+        {
+            frame.reset();
+            record(frame);
+            queue.submit(renderer, frame);
+        }
+
+        // entities whose world matrix changed in the last update
+        bool has_moved(entity_id id) const {
+            return moved[id.index] != 0;
+        }
+
+        // topmost entity with a hitbox under the point
+        entity_id pick(vec2<> point) const
+        {
+            pick_id pick = index.pick(point);
+            if (pick == no_pick)
+                return null_entity;
+
+            u32 i = pick_owner[pick];
+            return { i, gens[i] };
+        }
+
+    private:
+        // Where a sprite lands in the command queue: layer, then depth, 
+        // then recording order, which is slot order, see record().
+        u64 draw_order(u32 slot) const
+        {
+            const sprite& s = sprites[slot];
+            return ((u64)(u16)(s.layer + 0x8000) << 48) 
+                | ((u64)s.depth << 32) | slot;
+        }
+
+        // Folds the ancestors into a slot's own transform, so it stays in
+        // place at the root. Exact for ancestors that only translate, as 
+        // seats and hands do; rotations about z and scales are summed and
+        // multiplied, which is close for small ones.
+        void bake_root(u32 slot)
+        {
+            mat4<> m = get_root_mat({ slot, gens[slot] });
+            transform& t = transforms[slot];
+
+            for (u32 p = parents[slot]; p != no_parent; p = parents[p]) {
+                const transform& a = transforms[p];
+                t.rot = t.rot + a.rot;
+                t.sca = { t.sca.x * a.sca.x, t.sca.y * a.sca.y, 
+                    t.sca.z * a.sca.z };
+            }
+
+            t.pos = { m[3][0], m[3][1], m[3][2] };
+        }
+
+        // by depth in the hierarchy, slots keep their order within one
+        void sort_order()
+        {
+            const u32 n = (u32)masks.size();
+            std::pmr::vector<u32> depths(n, 0, &get_frame_arena());
+            for (u32 i = 0; i < n; ++i)
+                for (u32 p = parents[i]; p != no_parent; p = parents[p])
+                    ++depths[i];
+
+            order.resize(n);
+            std::iota(order.begin(), order.end(), 0u);
+            std::stable_sort(order.begin(), order.end(), 
+                [&depths](u32 a, u32 b) { return depths[a] < depths[b]; });
+
+            order_dirty = false;
+        }
+    };
+
+    // Owns one entity and destroys it along with itself, for objects 
+    // that live in a registry.
+    class scoped_entity {
+    private:
+        registry* reg;
+        entity_id id;
+
+    public:
+        scoped_entity()
+            : reg(nullptr), id(null_entity) {}
+
+        scoped_entity(registry& reg, u32 components, i32 layer = 0)
+            : reg(&reg), id(reg.create(components & ~component_hitbox))
+        {
+            // the layer has to be there before the hitbox is
+            reg.get_sprite(id).layer = layer;
+            reg.add(id, components);
+        }
+
+        ~scoped_entity() 
+        {
+            if (reg)
+                reg->destroy(id);
+        }
+
+        // non-copyable
+        scoped_entity(const scoped_entity&) = delete;
+        scoped_entity& operator=(const scoped_entity&) = delete;
+
+        // movable
+        scoped_entity(scoped_entity&& other)
+            : reg(std::exchange(other.reg, nullptr)),
+              id(std::exchange(other.id, null_entity)) {}
+
+        scoped_entity& operator=(scoped_entity&& other)
+        {
+            if (this != &other) 
+            {
+                if (reg)
+                    reg->destroy(id);
+
+                reg = std::exchange(other.reg, nullptr);
+                id = std::exchange(other.id, null_entity);
+            }
+            return *this;
+        }
+
+        entity_id get_id() const {
+            return id;
+        }
+
+        registry& get_registry() const {
+            return *reg;
+        }
+
+        transform& get_transform() const {
+            return reg->get_transform(id);
+        }
+
+        // see registry::set_parent
+        void set_parent(entity_id parent) const {
+            reg->set_parent(id, parent);
+        }
+
+        sprite& get_sprite() const {
+            return reg->get_sprite(id);
+        }
+
+        u32& get_state() const {
+            return reg->get_state(id);
+        }
+
+        // true when this is the topmost hitbox under the point
+        bool contains(vec2<> point) const {
+            return reg && reg->pick(point) == id;
+        }
+    };
+}
@@ -20,74 +20,263 @@
 
 export module tornasol:renderer;
 
+import :arena;
 import :buffer;
+import :camera;
 import :color;
+import :font;
+import :framebuffer;
 import :gl;
 import :glad;
+import :overdraw;
 import :rect;
+import :scaler;
 import :shader;
 import :size;
+import :sprite;
 import :texture;
 import :transform;
 import :types;
 import :vector;
 import :window;
 
+import <memory>;
+
 export namespace tornasol {
 
     class render_stats {
     public:
         u64 frame;
         u64 calls;
+        u64 state_changes; // binds and toggles that reached gl
+        u64 elided;        // and those the state cache skipped
+        u64 opaque;        // sprites drawn without blending
+        f64 overdraw;      // estimated, shaded pixels per pixel last frame
 
         render_stats() 
-            : frame(0), calls(0) {}
+            : frame(0), calls(0), state_changes(0), elided(0), opaque(0),
+              overdraw(0.0) {}
     };
 
     class renderer {
     private:
         render_stats stats;
         window& win;
+        unique<framebuffer> offscreen; // headless target
+        unique<render_scaler> scaler;  // unless drawn at native resolution
+        unique<sprite_renderer> sprites;
+        texture* batched; // of the pending sprites
+        bool premultiplied;
+        f32 depth;        // of the next sprites
+        bool depth_test;  // during the passes of a command queue
+        bool opaque_pass;
+        camera cam;
+        rect<i32> target_view; // viewport of the bound target
+        overdraw_meter overdraw;
 
     public:
-        renderer(glad_dep& glad, window& win)
-            : win(win)
+        // Everything is drawn in the camera's design coordinates, see 
+        // camera. Cursor positions reported by the window are mapped into
+        // them as well.
+        renderer(glad_dep& glad, window& win, 
+            render_quality quality = get_quality(quality_preset::high))
+            : win(win), batched(nullptr), premultiplied(false), depth(0.0f),
+              depth_test(false), opaque_pass(false), target_view(0, 0, 0, 0)
         {
             win.make_context_current();
-            size2<i32> viewport = win.get_size();
+            size2<i32> fb = win.get_framebuffer_size();
             
             glad.load();
-            gl::viewport(0, 0, viewport.w, viewport.h);
+            gl::load_extensions(glad.get_proc());
             gl::enable(gl::multisample);
             gl::enable(gl::blend);
             gl::blend_func(gl::src_alpha, gl::one_minus_src_alpha);
-            win.on_framebuffer_resize = [](size2<> s) {
-                gl::viewport(0, 0, s.w, s.h);
-            };
+            gl::pixel_store_i(gl::unpack_alignment, 1);
+            sprites = std::make_unique<sprite_renderer>();
+
+            // a headless window has no usable default framebuffer
+            if (win.is_headless())
+                offscreen = std::make_unique<framebuffer>(fb);
+            else
+                win.on_framebuffer_resize = [this](size2<> s) { resize(s); };
+
+            if (!quality.is_native())
+                scaler = std::make_unique<render_scaler>(quality);
+
+            resize(offscreen ? offscreen->get_size() : fb);
         }
 
-        render_stats get_stats() const {
-            return stats;
+        render_stats get_stats() const 
+        {
+            render_stats s = stats;
+            s.state_changes = gl::get_state_changes();
+            s.elided = gl::get_elided_calls();
+            return s;
         }
 
         window& get_window() const {
             return win;
         }
 
-        mat4<> get_proj_mat() const
+        bool is_offscreen() const {
+            return offscreen != nullptr;
+        }
+
+        const camera& get_camera() const {
+            return cam;
+        }
+
+        // Size of what the frame is drawn into: the letterboxed part of 
+        // the window, smaller when scaled.
+        size2<i32> get_render_size() const 
+        {
+            const rect<i32>& vp = cam.get_viewport();
+            size2<i32> size = { vp.w, vp.h };
+            return scaler ? scaler->get_size(size) : size;
+        }
+
+        // Follows the framebuffer size, called by the window on resize. 
+        // Nothing else about the view changes between frames.
+        void resize(size2<i32> fb)
+        {
+            cam.resize(fb);
+
+            // cursor positions go from window coordinates to pixels, 
+            // then into the design
+            size2<i32> w = win.get_size();
+            f32 dpi_x = w.w > 0 ? (f32)fb.w / (f32)w.w : 1.0f;
+            f32 dpi_y = w.h > 0 ? (f32)fb.h / (f32)w.h : 1.0f;
+            const rect<i32>& vp = cam.get_viewport();
+            f32 s = cam.get_scale();
+
+            win.set_cursor_mapping({ dpi_x / s, dpi_y / s }, 
+                { -(f32)vp.x / s, -(f32)vp.y / s });
+
+            bind_target(nullptr);
+        }
+
+        // Renders into the given framebuffer from now on, or back into the
+        // window with nullptr.
+        void bind_target(framebuffer* target)
+        {
+            flush();
+
+            if (!target && scaler) 
+            {
+                const rect<i32>& vp = cam.get_viewport();
+                target = &scaler->get_target({ vp.w, vp.h });
+            }
+
+            // framebuffers are drawn whole, the window letterboxed
+            if (target) {
+                size2<i32> size = target->get_size();
+                target->bind();
+                target_view = { 0, 0, size.w, size.h };
+            }
+            else {
+                bind_output();
+                target_view = cam.get_viewport();
+            }
+
+            gl::viewport(target_view.x, target_view.y, 
+                target_view.w, target_view.h);
+        }
+
+        // Clips drawing to a rect in design coordinates, top-left origin.
+        void set_scissor(const rect<>& area)
+        {
+            flush();
+
+            size2<i32> design = cam.get_design();
+            const rect<i32>& v = target_view;
+            f32 sx = (f32)v.w / (f32)design.w;
+            f32 sy = (f32)v.h / (f32)design.h;
+
+            gl::enable(gl::scissor_test);
+            gl::scissor(v.x + (i32)(area.x * sx), 
+                v.y + v.h - (i32)((area.y + area.h) * sy), 
+                (i32)(area.w * sx), (i32)(area.h * sy));
+        }
+
+        void clear_scissor() {
+            flush();
+            gl::disable(gl::scissor_test);
+        }
+
+        void set_blending(bool enabled) 
+        {
+            flush();
+            if (enabled)
+                gl::enable(gl::blend);
+            else
+                gl::disable(gl::blend);
+        }
+
+        // Depth of the sprites drawn next, between -1 (far) and 1 (near). 
+        // It only matters between begin_opaque() and end_depth().
+        void set_depth(f32 value) {
+            depth = value;
+        }
+
+        // Starts drawing opaque sprites, front to back, with the depth test
+        // on and blending off: hidden pixels are rejected before shading.
+        // Clears the depth of the bound target.
+        void begin_opaque()
+        {
+            flush();
+            gl::enable(gl::depth_test);
+            gl::depth_func(gl::lequal);
+            gl::depth_mask(true);
+            gl::disable(gl::blend);
+            gl::clear(gl::depth_buffer_bit);
+
+            overdraw.clear(cam.get_design());
+            depth_test = true;
+            opaque_pass = true;
+        }
+
+        // Then the translucent ones, back to front, blended and tested 
+        // against the opaque ones without writing depth.
+        void begin_translucent()
+        {
+            flush();
+            gl::depth_mask(false);
+            gl::enable(gl::blend);
+            opaque_pass = false;
+        }
+
+        void end_depth()
         {
-            size2<i32> viewport = win.get_size();
-            return ortho(0.0f, (f32)viewport.w, (f32)viewport.h, 0.0f, -1.0f, 1.0f);
+            flush();
+            gl::disable(gl::depth_test);
+            gl::depth_mask(true);
+            gl::enable(gl::blend);
+            depth_test = false;
+            opaque_pass = false;
+            depth = 0.0f;
+        }
+
+        // the camera's, rebuilt on resize only
+        const mat4<>& get_proj_mat() const {
+            return cam.get_proj();
         }
 
         void clear(color bg)
         {
+            flush();
             gl::clear_color(bg.r, bg.g, bg.b, bg.a);
             gl::clear(gl::color_buffer_bit);
+            overdraw.clear(cam.get_design());
         }
 
         void render(texture_renderer& tex) 
         {
+            if (!tex.prepare())
+                return;
+
+            flush();
+            set_premultiplied(tex.get_texture().is_premultiplied());
+
             tex.get_vao().bind();
             tex.get_vbo().bind();
             tex.get_ibo().bind();
@@ -101,8 +290,108 @@ export namespace tornasol {
             ++stats.calls;
         }
 
-        void present() {
-            win.swap_buffers();
+        // Draws a texture over a rect. Sprites are batched, consecutive 
+        // ones with the same texture go out in one draw call.
+        void render(texture& tex, const rect<>& area, const mat4<>& model,
+            const rect<>& uv = { 0.0f, 0.0f, 1.0f, 1.0f }, 
+            const color& tint = { 1.0f, 1.0f, 1.0f, 1.0f })
+        {
+            if (!tex.is_ready())
+                return;
+
+            if (&tex != batched || sprites->full())
+                flush();
+
+            set_premultiplied(tex.is_premultiplied());
+            sprites->push(area, model, uv, tint, depth);
+            batched = &tex;
+
+            overdraw.add(area, model, depth, depth_test, opaque_pass);
+            if (opaque_pass)
+                ++stats.opaque;
+        }
+
+        // Draws the glyph quads of shaped text from the font's atlas, they
+        // join the sprite batch.
+        void render(texture& atlas, const shaped_text& text, 
+            const mat4<>& model, const color& tint)
+        {
+            for (const glyph_quad& q : text.quads)
+                render(atlas, q.area, model, q.uv, tint);
+        }
+
+        // Draws the pending sprites, state changes do it on their own.
+        void flush()
+        {
+            if (!batched)
+                return;
+
+            batched->bind();
+            stats.calls += sprites->flush(get_proj_mat(), 
+                batched->is_distance_field());
+            batched = nullptr;
+        }
+
+        // cooked textures carry premultiplied alpha, the blend equation
+        // has to match or their edges come out dark
+        void set_premultiplied(bool value)
+        {
+            if (value == premultiplied)
+                return;
+
+            flush();
+            gl::blend_func(value ? gl::one : gl::src_alpha, 
+                gl::one_minus_src_alpha);
+            premultiplied = value;
+        }
+
+        void present() 
+        {
+            flush();
+
+            // stretch the scaled frame over the window, between the bars
+            if (scaler)
+            {
+                scaler->resolve();
+                bind_output();
+                gl::clear_color(0.0f, 0.0f, 0.0f, 1.0f);
+                gl::clear(gl::color_buffer_bit);
+
+                const rect<i32>& vp = cam.get_viewport();
+                gl::viewport(vp.x, vp.y, vp.w, vp.h);
+                gl::disable(gl::blend);
+                scaler->draw();
+                gl::enable(gl::blend);
+                ++stats.calls;
+            }
+
+            sprites->end_frame();
+            stats.overdraw = overdraw.take(cam.get_design());
+
+            // offscreen there is nothing to swap, wait for the gpu instead
+            // so frame times account for the whole frame
+            if (offscreen)
+                gl::finish();
+            else
+                win.swap_buffers();
+
+            ++stats.frame;
+
+            if (scaler)
+                bind_target(nullptr);
+
+            // the frame is over, so is its transient memory
+            get_frame_arena().reset();
+        }
+
+    private:
+        // what is shown, the window or the headless target
+        void bind_output()
+        {
+            if (offscreen)
+                offscreen->bind();
+            else
+                gl::bind_framebuffer(gl::framebuffer, 0);
         }
     };
 }
\ No newline at end of file
@@ -0,0 +1,196 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module tornasol:scaler;
+
+import :buffer;
+import :framebuffer;
+import :gl;
+import :shader;
+import :size;
+import :types;
+import :vector;
+
+import <algorithm>;
+import <cmath>;
+import <memory>;
+
+export namespace tornasol {
+
+    enum class quality_preset
+    {
+        low,    // software renderers, half resolution
+        medium, // integrated gpus, fxaa instead of msaa
+        high    // native resolution, 4x msaa
+    };
+
+    struct render_quality {
+        f32 scale;   // of the internal resolution to the window's
+        u32 samples; // msaa, 0 for none
+        bool fxaa;   // smooths edges while upscaling, cheaper than msaa
+
+        // drawn straight into the window, which does the multisampling
+        bool is_native() const {
+            return scale == 1.0f && !fxaa;
+        }
+
+        u32 get_window_samples() const {
+            return is_native() ? samples : 0;
+        }
+    };
+
+    render_quality get_quality(quality_preset preset)
+    {
+        switch (preset) {
+        case quality_preset::low:    return { 0.5f, 0, false };
+        case quality_preset::medium: return { 0.75f, 0, true };
+        default:                     return { 1.0f, 4, false };
+        }
+    }
+
+    // Renders the frame at a fraction of the window's resolution, into a 
+    // framebuffer multisampled if asked, then stretches it over the window,
+    // optionally through an fxaa pass.
+    class render_scaler {
+    private:
+        render_quality quality;
+        unique<framebuffer> target;   // internal resolution
+        unique<framebuffer> resolved; // of a multisampled target
+        vertex_array vao; // empty, the triangle comes from gl_VertexID
+        shader shader;
+
+    public:
+        render_scaler(render_quality quality)
+            : quality(quality)
+        {
+            const char vertex_src[] =
+                " #version 400 core\n                                       "
+                " out vec2 uv;\n                                            "
+                " void main()\n                                             "
+                " {\n                                                       "
+                "     vec2 p = vec2((gl_VertexID << 1) & 2,\n               "
+                "                   gl_VertexID & 2);\n                     "
+                "     uv = p;\n                                             "
+                "     gl_Position = vec4(p * 2.0 - 1.0, 0, 1);\n            "
+                " }\0                                                       ";
+
+            // fxaa in its compact form: blur along the edge direction found
+            // from the luma of the diagonal neighbours, unless that leaves
+            // the local luma range
+            const char fragment_src[] =
+                " #version 400 core\n                                        "
+                " in  vec2 uv;\n                                             "
+                " out vec4 frag;\n                                           "
+                " uniform sampler2D tex;\n                                   "
+                " uniform vec2 texel;\n                                      "
+                " uniform int fxaa;\n                                        "
+                " float luma(vec3 c) {\n                                    "
+                "    return dot(c, vec3(0.299, 0.587, 0.114));\n            "
+                " }\n                                                        "
+                " vec3 at(vec2 p) { return texture(tex, p).rgb; }\n          "
+                " void main()\n                                              "
+                " {\n                                                        "
+                "    vec3 c = at(uv);\n                                      "
+                "    if (fxaa == 0) { frag = vec4(c, 1); return; }\n         "
+                "    float nw = luma(at(uv + vec2(-1, -1) * texel));\n       "
+                "    float ne = luma(at(uv + vec2( 1, -1) * texel));\n       "
+                "    float sw = luma(at(uv + vec2(-1,  1) * texel));\n       "
+                "    float se = luma(at(uv + vec2( 1,  1) * texel));\n       "
+                "    float m  = luma(c);\n                                   "
+                "    float lo = min(m, min(min(nw, ne), min(sw, se)));\n     "
+                "    float hi = max(m, max(max(nw, ne), max(sw, se)));\n     "
+                "    vec2 dir = vec2((sw + se) - (nw + ne),\n                "
+                "                    (nw + sw) - (ne + se));\n               "
+                "    float r = max((nw + ne + sw + se) * 0.03125, 0.0078125);\n"
+                "    float k = 1.0 / (min(abs(dir.x), abs(dir.y)) + r);\n    "
+                "    dir = clamp(dir * k, -8.0, 8.0) * texel;\n              "
+                "    vec3 a = 0.5 * (at(uv - dir / 6.0)\n                    "
+                "                  + at(uv + dir / 6.0));\n                 "
+                "    vec3 b = 0.5 * a + 0.25 * (at(uv - dir * 0.5)\n         "
+                "                             + at(uv + dir * 0.5));\n      "
+                "    float l = luma(b);\n                                    "
+                "    frag = vec4(l < lo || l > hi ? a : b, 1);\n             "
+                " }\0                                                        ";
+
+            shader_source vertex(shader_type::vertex);
+            vertex.compile(vertex_src);
+            shader_source fragment(shader_type::fragment);
+            fragment.compile(fragment_src);
+
+            shader.attach(vertex);
+            shader.attach(fragment);
+            shader.link();
+        }
+
+        // non-copyable
+        render_scaler(const render_scaler&) = delete;
+        render_scaler& operator=(const render_scaler&) = delete;
+
+        const render_quality& get_quality() const {
+            return quality;
+        }
+
+        size2<i32> get_size(size2<i32> window) const
+        {
+            return { 
+                std::max((i32)std::lround(window.w * quality.scale), 1),
+                std::max((i32)std::lround(window.h * quality.scale), 1) 
+            };
+        }
+
+        // What the frame is drawn into for a window size, reallocated when
+        // the window resizes.
+        framebuffer& get_target(size2<i32> window)
+        {
+            size2<i32> size = get_size(window);
+            if (!target || target->get_size() != size)
+            {
+                target = std::make_unique<framebuffer>(size, quality.samples);
+                resolved = quality.samples 
+                    ? std::make_unique<framebuffer>(size) : nullptr;
+            }
+
+            return *target;
+        }
+
+        // Resolves the samples, if any. Leaves no framebuffer bound.
+        void resolve()
+        {
+            if (resolved)
+                target->resolve(*resolved);
+        }
+
+        // Stretches the frame over the bound framebuffer, blending must be
+        // off.
+        void draw()
+        {
+            framebuffer& src = resolved ? *resolved : *target;
+            size2<i32> size = src.get_size();
+
+            src.get_color()->bind();
+            vao.bind();
+            shader.use();
+            shader.set_uniform("fxaa", quality.fxaa ? 1 : 0);
+            shader.set_uniform("texel", 
+                vec2<>{ 1.0f / (f32)size.w, 1.0f / (f32)size.h });
+            gl::draw_arrays(gl::triangles, 0, 3);
+        }
+    };
+}
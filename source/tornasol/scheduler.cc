@@ -0,0 +1,146 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module tornasol:scheduler;
+
+import :glfw;
+import :input;
+import :types;
+import :window;
+
+import <algorithm>;
+import <atomic>;
+import <chrono>;
+
+namespace tornasol {
+
+    std::atomic<bool> redraw_requested = true;
+    std::atomic<i64> animate_until = 0;
+
+    i64 scheduler_now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+export namespace tornasol {
+
+    // Asks for one more frame. Safe from any thread, wakes the main loop
+    // if it is sleeping.
+    void request_redraw()
+    {
+        if (!redraw_requested.exchange(true))
+            glfw::post_empty_event();
+    }
+
+    // Keeps frames coming for the next seconds, for animations that
+    // advance on their own.
+    void request_animation(f64 seconds)
+    {
+        i64 until = scheduler_now() + i64(seconds * 1e9);
+        i64 curr = animate_until.load();
+
+        while (curr < until && !animate_until.compare_exchange_weak(curr, until))
+            ;
+
+        request_redraw();
+    }
+
+    // Decides when the main loop produces a frame. Redraws only when an 
+    // event arrived, something requested it or an animation is running,
+    // and sleeps in wait_events otherwise instead of spinning.
+    //
+    // Needs the window's context current, so create it after the renderer.
+    class frame_scheduler {
+    private:
+        window& win;
+        f64 fps_cap;
+        f64 idle_timeout;
+        u64 seen_events;
+        i64 last_frame;
+
+    public:
+        frame_scheduler(window& win, i32 swap_interval = 1, 
+            f64 fps_cap = 0.0, f64 idle_timeout = 0.5)
+            : win(win), fps_cap(fps_cap), idle_timeout(idle_timeout), 
+              seen_events(0), last_frame(0)
+        {
+            set_swap_interval(swap_interval);
+        }
+
+        // non-copyable
+        frame_scheduler(const frame_scheduler&) = delete;
+        frame_scheduler& operator=(const frame_scheduler&) = delete;
+
+        void set_swap_interval(i32 interval) {
+            glfw::swap_interval(interval);
+        }
+
+        // frames per second, zero leaves pacing to the swap interval
+        f64 get_fps_cap() const {
+            return fps_cap;
+        }
+
+        void set_fps_cap(f64 cap) {
+            fps_cap = cap;
+        }
+
+        // longest sleep while idle, bounds how stale the table can get
+        f64 get_idle_timeout() const {
+            return idle_timeout;
+        }
+
+        void set_idle_timeout(f64 timeout) {
+            idle_timeout = timeout;
+        }
+
+        bool is_animating() const {
+            return scheduler_now() < animate_until.load();
+        }
+
+        bool is_frame_due() const
+        {
+            return redraw_requested.load() || is_animating()
+                || win.get_event_count() != seen_events;
+        }
+
+        // Pulls events and returns once the next frame should be drawn.
+        void wait()
+        {
+            pull_events();
+
+            if (!is_frame_due())
+                wait_events_timeout(idle_timeout);
+
+            if (fps_cap > 0.0)
+            {
+                i64 next = last_frame + i64(1e9 / fps_cap);
+                for (i64 now = scheduler_now(); now < next; 
+                    now = scheduler_now())
+                    wait_events_timeout((next - now) / 1e9);
+            }
+
+            seen_events = win.get_event_count();
+            redraw_requested = false;
+            last_frame = scheduler_now();
+        }
+    };
+}
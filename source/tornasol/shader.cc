@@ -159,6 +159,14 @@ export namespace tornasol {
             return gl::get_uniform_location(id, name);
         }
 
+        void set_uniform(const char* name, i32 v) {
+            gl::uniform_1i(get_location(name), v);
+        }
+
+        void set_uniform(const char* name, f32 v) {
+            gl::uniform_1f(get_location(name), v);
+        }
+
         void set_uniform(const char* name, const vec2<>& v) {
             gl::uniform_2f(get_location(name), v.x, v.y);
         }
@@ -0,0 +1,321 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module tornasol:spatial;
+
+import :matrix;
+import :rect;
+import :types;
+import :vector;
+
+import <algorithm>;
+import <cmath>;
+import <iterator>;
+import <unordered_map>;
+import <utility>;
+import <vector>;
+
+export namespace tornasol {
+
+    using pick_id = u32;
+    constexpr pick_id no_pick = ~0u;
+
+    // Uniform grid over screen space for pointer queries. Items are local
+    // rectangles under a model matrix, so rotated and scaled sprites are
+    // picked exactly: the point is taken back to local space through the
+    // inverse matrix. Only items whose cells the point falls in are tested.
+    // Each item carries its place in the draw order, the topmost drawn is
+    // the one picked.
+    class spatial_index {
+    private:
+        struct item {
+            rect<> local;
+            mat4<> model;
+            f32 inv[6];      // inverse of the 2d affine part of model
+            u64 order;       // higher is drawn on top
+            i32 x0, y0, x1, y1; // covered cells
+            bool live;
+        };
+
+        f32 cell_size;
+        std::vector<item> items;
+        std::vector<pick_id> free;
+        std::unordered_map<u64, std::vector<pick_id>> cells;
+
+        // the last query, pointer queries repeat a lot within a frame
+        mutable vec2<> last_point;
+        mutable pick_id last_pick;
+        mutable bool last_valid;
+
+    public:
+        spatial_index(f32 cell_size = 128.0f)
+            : cell_size(cell_size), last_pick(no_pick), last_valid(false) {}
+
+        // non-copyable
+        spatial_index(const spatial_index&) = delete;
+        spatial_index& operator=(const spatial_index&) = delete;
+
+        pick_id insert(rect<> local, const mat4<>& model, u64 order = 0)
+        {
+            pick_id id;
+            if (!free.empty()) {
+                id = free.back();
+                free.pop_back();
+            }
+            else {
+                id = (pick_id)items.size();
+                items.emplace_back();
+            }
+
+            item& it = items[id];
+            it.live = true;
+            it.order = order;
+            place(it, local, model);
+            link(id);
+            return id;
+        }
+
+        // Cheap when nothing moved, and the grid is only touched when the
+        // bounds cross into other cells.
+        void update(pick_id id, rect<> local, const mat4<>& model,
+            u64 order)
+        {
+            item& it = items[id];
+            if (it.order != order) {
+                it.order = order;
+                last_valid = false;
+            }
+
+            if (it.local == local && it.model == model)
+                return;
+
+            item prev = it;
+            place(it, local, model);
+
+            if (prev.x0 != it.x0 || prev.y0 != it.y0 
+                || prev.x1 != it.x1 || prev.y1 != it.y1)
+            {
+                unlink(id, prev);
+                link(id);
+            }
+        }
+
+        void remove(pick_id id)
+        {
+            unlink(id, items[id]);
+            items[id].live = false;
+            free.push_back(id);
+            last_valid = false;
+        }
+
+        // Topmost item under the point by draw order, or no_pick.
+        pick_id pick(vec2<> point) const
+        {
+            if (last_valid && last_point == point)
+                return last_pick;
+
+            pick_id best = no_pick;
+            auto found = cells.find(key(cell(point.x), cell(point.y)));
+
+            if (found != cells.end())
+                for (pick_id id : found->second)
+                {
+                    const item& it = items[id];
+                    if (!hit(it, point))
+                        continue;
+
+                    if (best == no_pick || it.order > items[best].order)
+                        best = id;
+                }
+
+            last_point = point;
+            last_pick = best;
+            last_valid = true;
+            return best;
+        }
+
+        // Every item under the point, unordered.
+        void query(vec2<> point, std::vector<pick_id>& out) const
+        {
+            auto found = cells.find(key(cell(point.x), cell(point.y)));
+            if (found == cells.end())
+                return;
+
+            for (pick_id id : found->second)
+                if (hit(items[id], point))
+                    out.push_back(id);
+        }
+
+        usize get_size() const {
+            return items.size() - free.size();
+        }
+
+    private:
+        i32 cell(f32 v) const {
+            return (i32)std::floor(v / cell_size);
+        }
+
+        static u64 key(i32 x, i32 y) {
+            return ((u64)(u32)x << 32) | (u32)y;
+        }
+
+        static bool hit(const item& it, vec2<> p)
+        {
+            f32 x = it.inv[0] * p.x + it.inv[2] * p.y + it.inv[4];
+            f32 y = it.inv[1] * p.x + it.inv[3] * p.y + it.inv[5];
+            return it.local.contains({ x, y });
+        }
+
+        void place(item& it, rect<> local, const mat4<>& model)
+        {
+            it.local = local;
+            it.model = model;
+
+            // x' = a x + c y + e, y' = b x + d y + f
+            f32 a = model[0][0], b = model[0][1];
+            f32 c = model[1][0], d = model[1][1];
+            f32 e = model[3][0], f = model[3][1];
+            f32 det = a * d - b * c;
+
+            if (det == 0.0f) {
+                // degenerate, can't be hit
+                std::fill(std::begin(it.inv), std::end(it.inv), 0.0f);
+                it.local = { 0.0f, 0.0f };
+                it.x0 = it.y0 = 0;
+                it.x1 = it.y1 = -1;
+                last_valid = false;
+                return;
+            }
+
+            it.inv[0] =  d / det;
+            it.inv[1] = -b / det;
+            it.inv[2] = -c / det;
+            it.inv[3] =  a / det;
+            it.inv[4] = (c * f - d * e) / det;
+            it.inv[5] = (b * e - a * f) / det;
+
+            // world bounds of the four corners
+            f32 xs[2] = { local.x, local.x + local.w };
+            f32 ys[2] = { local.y, local.y + local.h };
+            f32 min_x = INFINITY, min_y = INFINITY;
+            f32 max_x = -INFINITY, max_y = -INFINITY;
+
+            for (f32 x : xs)
+            for (f32 y : ys)
+            {
+                f32 wx = a * x + c * y + e;
+                f32 wy = b * x + d * y + f;
+                min_x = std::min(min_x, wx);
+                min_y = std::min(min_y, wy);
+                max_x = std::max(max_x, wx);
+                max_y = std::max(max_y, wy);
+            }
+
+            it.x0 = cell(min_x);
+            it.y0 = cell(min_y);
+            it.x1 = cell(max_x);
+            it.y1 = cell(max_y);
+            last_valid = false;
+        }
+
+        void link(pick_id id)
+        {
+            const item& it = items[id];
+
+            for (i32 y = it.y0; y <= it.y1; ++y)
+            for (i32 x = it.x0; x <= it.x1; ++x)
+                cells[key(x, y)].push_back(id);
+        }
+
+        void unlink(pick_id id, const item& it)
+        {
+            for (i32 y = it.y0; y <= it.y1; ++y)
+            for (i32 x = it.x0; x <= it.x1; ++x)
+            {
+                auto& ids = cells[key(x, y)];
+                ids.erase(std::find(ids.begin(), ids.end(), id));
+            }
+
+            last_valid = false;
+        }
+    };
+
+    // Owns one item of an index and removes it when destroyed, so 
+    // entities can hold their pickable area by value.
+    class pick_handle {
+    private:
+        spatial_index* index;
+        pick_id id;
+
+    public:
+        pick_handle()
+            : index(nullptr), id(no_pick) {}
+
+        pick_handle(spatial_index& index, u64 order = 0)
+            : index(&index), id(index.insert({}, mat4<>(1.0f), order)) {}
+
+        ~pick_handle() 
+        {
+            if (index)
+                index->remove(id);
+        }
+
+        // non-copyable
+        pick_handle(const pick_handle&) = delete;
+        pick_handle& operator=(const pick_handle&) = delete;
+
+        // movable
+        pick_handle(pick_handle&& other)
+            : index(std::exchange(other.index, nullptr)),
+              id(std::exchange(other.id, no_pick)) {}
+
+        pick_handle& operator=(pick_handle&& other)
+        {
+            if (this != &other) 
+            {
+                if (index)
+                    index->remove(id);
+
+                index = std::exchange(other.index, nullptr);
+                id = std::exchange(other.id, no_pick);
+            }
+            return *this;
+        }
+
+        pick_id get_id() const {
+            return id;
+        }
+
+        bool is_valid() const {
+            return index != nullptr;
+        }
+
+        void update(rect<> local, const mat4<>& model, u64 order) 
+        {
+            if (index)
+                index->update(id, local, model, order);
+        }
+
+        // true when this is the topmost item under the point
+        bool contains(vec2<> point) const {
+            return index && index->pick(point) == id;
+        }
+    };
+}
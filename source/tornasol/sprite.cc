@@ -0,0 +1,220 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module tornasol:sprite;
+
+import :buffer;
+import :color;
+import :gl;
+import :matrix;
+import :rect;
+import :shader;
+import :types;
+import :vector;
+
+import <vector>;
+
+export namespace tornasol {
+
+    struct sprite_vertex {
+        f32 x, y; // window coordinates
+        f32 z;    // depth, nearer is higher, see renderer::set_depth
+        f32 u, v;
+        u8 rgba[4]; // tint
+    };
+
+    // Sprites are transformed on the cpu and collected as quads, then 
+    // drawn with one call per run of sprites sharing a texture. Vertices 
+    // stream through a ring buffer, indices are fixed. Distance field 
+    // textures, glyph atlases, are drawn as a tinted edge instead.
+    class sprite_renderer {
+    public:
+        static constexpr u32 max_quads = 4096;
+
+    private:
+        static constexpr u32 region_size = 
+            max_quads * 4 * sizeof(sprite_vertex);
+
+        vertex_array  vao;
+        stream_buffer vbo;
+        vertex_buffer ibo;
+        shader shader;
+        std::vector<sprite_vertex> quads;
+        mat4<> proj; // last uploaded
+
+    public:
+        sprite_renderer()
+            : vbo(buffer_type::vertex, region_size), 
+              ibo(buffer_type::index), proj(0.0f)
+        {
+            const char vertex_src[] =
+                " #version 400 core\n                                "
+                " layout (location = 0) in vec3 pos;\n               "
+                " layout (location = 1) in vec2 uv;\n                "
+                " layout (location = 2) in vec4 color;\n             "
+                " out vec2 tex_coord;\n                              "
+                " out vec4 tint;\n                                   "
+                " uniform mat4 proj;\n                               "
+                " void main()\n                                      "
+                " {\n                                                "
+                "     gl_Position = proj * vec4(pos, 1);\n           "
+                "     tex_coord = uv;\n                              "
+                "     tint = color;\n                                "
+                " }\0                                                ";
+
+            const char fragment_src[] =
+                " #version 400 core\n                                    "
+                " out vec4 frag;\n                                       "
+                " in  vec2 tex_coord;\n                                  "
+                " in  vec4 tint;\n                                       "
+                " uniform sampler2D tex;\n                               "
+                " uniform int sdf;\n                                     "
+                " void main()\n                                          "
+                " {\n                                                    "
+                "    vec4 t = texture(tex, tex_coord);\n                 "
+                "    if (sdf == 0) { frag = t * tint; return; }\n        "
+                "    float w = max(fwidth(t.a) * 0.75, 1e-4);\n          "
+                "    float a = smoothstep(0.5 - w, 0.5 + w, t.a);\n      "
+                "    frag = vec4(tint.rgb, tint.a * a);\n                "
+                " }\0                                                    ";
+
+            shader_source vertex(shader_type::vertex);
+            vertex.compile(vertex_src);
+            shader_source fragment(shader_type::fragment);
+            fragment.compile(fragment_src);
+            
+            shader.attach(vertex);
+            shader.attach(fragment);
+            shader.link();
+
+            std::vector<u32> indices(max_quads * 6);
+            for (u32 q = 0; q < max_quads; ++q)
+            {
+                const u32 i[] = { 0, 1, 3, 1, 2, 3 };
+                for (u32 k = 0; k < 6; ++k)
+                    indices[q * 6 + k] = q * 4 + i[k];
+            }
+
+            vao.bind();
+            vbo.bind();
+            ibo.bind();
+            ibo.load(indices.data(), (u32)(indices.size() * sizeof(u32)), 
+                buffer_usage::static_draw);
+
+            vao.attribute(0, 3, gl::type_float, false, 
+                sizeof(sprite_vertex), 0);
+            vao.attribute(1, 2, gl::type_float, false, 
+                sizeof(sprite_vertex), 3 * sizeof(f32));
+            vao.attribute(2, 4, gl::type_ubyte, true, 
+                sizeof(sprite_vertex), 5 * sizeof(f32));
+            vao.enable_attribute(0);
+            vao.enable_attribute(1);
+            vao.enable_attribute(2);
+
+            quads.reserve(max_quads * 4);
+        }
+
+        // non-copyable
+        sprite_renderer(const sprite_renderer&) = delete;
+        sprite_renderer& operator=(const sprite_renderer&) = delete;
+
+        ts::shader& get_shader() {
+            return shader;
+        }
+
+        bool is_persistent() const {
+            return vbo.is_persistent();
+        }
+
+        bool empty() const {
+            return quads.empty();
+        }
+
+        bool full() const {
+            return quads.size() >= max_quads * 4;
+        }
+
+        // Adds the rect, placed by model, to the pending quads. The uv 
+        // rect is the part of the texture shown, gl orientation.
+        void push(const rect<>& r, const mat4<>& m, 
+            const rect<>& uv = { 0.0f, 0.0f, 1.0f, 1.0f }, 
+            const color& tint = { 1.0f, 1.0f, 1.0f, 1.0f }, 
+            f32 depth = 0.0f)
+        {
+            const u8 c8[4] = {
+                (u8)(tint.r * 255.0f + 0.5f), (u8)(tint.g * 255.0f + 0.5f),
+                (u8)(tint.b * 255.0f + 0.5f), (u8)(tint.a * 255.0f + 0.5f)
+            };
+
+            // corners of the unit quad, the texture's top is at v = 1
+            const f32 corners[4][2] = { 
+                { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f }, { 0.0f, 0.0f } 
+            };
+
+            for (auto& c : corners)
+            {
+                f32 x = r.x + c[0] * r.w;
+                f32 y = r.y + c[1] * r.h;
+
+                quads.push_back({
+                    m[0][0] * x + m[1][0] * y + m[3][0],
+                    m[0][1] * x + m[1][1] * y + m[3][1],
+                    depth,
+                    uv.x + c[0] * uv.w, uv.y + (1.0f - c[1]) * uv.h,
+                    { c8[0], c8[1], c8[2], c8[3] }
+                });
+            }
+        }
+
+        // Draws the pending quads with the bound texture, returns the 
+        // number of draw calls made.
+        u32 flush(const mat4<>& proj, bool distance_field)
+        {
+            if (quads.empty())
+                return 0;
+
+            u32 bytes = (u32)(quads.size() * sizeof(sprite_vertex));
+            u32 at = vbo.write(quads.data(), bytes, sizeof(sprite_vertex));
+
+            vao.bind();
+            shader.use();
+
+            // the projection only changes on resize
+            if (!(proj == this->proj)) {
+                shader.set_uniform("proj", proj);
+                this->proj = proj;
+            }
+
+            shader.set_uniform("sdf", distance_field ? 1 : 0);
+
+            gl::draw_elements_base_vertex(gl::triangles, 
+                (i32)(quads.size() / 4 * 6), gl::type_uint, nullptr, 
+                (i32)(at / sizeof(sprite_vertex)));
+
+            quads.clear();
+            return 1;
+        }
+
+        // once per frame, after the last flush
+        void end_frame() {
+            vbo.end_frame();
+        }
+    };
+}
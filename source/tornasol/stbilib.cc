@@ -21,6 +21,8 @@
 export module tornasol:stbi;
 import :types;
 import "stb_image.h";
+import <cstdlib>;
+import <new>;
 import <stdexcept>;
 
 export namespace tornasol::stbi {
@@ -29,6 +31,12 @@ export namespace tornasol::stbi {
       stbi_set_flip_vertically_on_load(flip);
    }
 
+   // thread-local override, lets decoder threads flip without racing on
+   // the global flag
+   void set_flip_vertically_on_load_thread(bool flip) {
+      stbi_set_flip_vertically_on_load_thread(flip);
+   }
+
    byte* load(const char* filename, int* x, int* y, int* comp, int req_comp)
    {
       byte* data = (byte*) stbi_load(filename, x, y, comp, req_comp);
@@ -39,6 +47,30 @@ export namespace tornasol::stbi {
       return data;
    }
 
+   byte* load_from_memory(const byte* buffer, int len, int* x, int* y, 
+      int* comp, int req_comp)
+   {
+      byte* data = (byte*) stbi_load_from_memory((const stbi_uc*)buffer, len,
+         x, y, comp, req_comp);
+      
+      if (data == nullptr)
+         throw std::runtime_error("failed to load image");
+      
+      return data;
+   }
+
+   // pixels allocated here can be released with free(), which is what 
+   // stbi_image_free does with the default allocator
+   byte* alloc(usize size)
+   {
+      byte* data = (byte*) std::malloc(size);
+
+      if (data == nullptr)
+         throw std::bad_alloc();
+
+      return data;
+   }
+
    void free(byte* data) {
       stbi_image_free(data);
    }
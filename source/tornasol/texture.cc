@@ -25,9 +25,13 @@ import :gl;
 import :image;
 import :rect;
 import :shader;
+import :size;
 import :types;
 import :util;
 
+import <algorithm>;
+import <atomic>;
+import <memory>;
 import <utility>;
 
 export namespace tornasol {
@@ -53,27 +57,96 @@ export namespace tornasol {
     class texture {
     private:
         u32 id;
+        size2<i32> size;
+        usize memory;
+        std::atomic<bool> ready; // size is only read once this is set
+        bool premultiplied;
+        bool distance_field;
+        bool opaque;
+        texture_format format;
+        u32 levels; // of the allocated chain
+        u32 loaded; // levels uploaded so far
+        bool immutable; // storage from tex_storage_2d, fixed for good
+        // sampling, set again on a new name, see renew()
+        bool sampled;
+        texture_wrap wrap_s, wrap_t;
+        texture_filter min_filter, mag_filter;
 
     public:
-        texture() {
-            id = gl::gen_texture();
-        }
-
-        ~texture() {
-            gl::delete_texture(id);
+        // The gl name is created on first bind, so textures can be handed
+        // out by threads that don't own the context.
+        texture() 
+            : id(0), size({ 0, 0 }), memory(0), ready(false), 
+              premultiplied(false), distance_field(false), opaque(false),
+              format(texture_format::rgba), 
+              levels(0), loaded(0), immutable(false), sampled(false),
+              wrap_s(texture_wrap::repeat), wrap_t(texture_wrap::repeat),
+              min_filter(texture_filter::linear), 
+              mag_filter(texture_filter::linear) {}
+
+        ~texture() 
+        {
+            if (id)
+                gl::delete_texture(id);
         }
 
         u32 get_id() const {
             return id;
         }
 
+        // zero until ready
+        size2<i32> get_size() const {
+            return ready ? size : size2<i32>{ 0, 0 };
+        }
+
+        // estimated video memory, including the mip chain
+        usize get_memory() const {
+            return memory;
+        }
+
+        // false until pixels have been uploaded, e.g. while the image is 
+        // still being decoded by a texture_loader
+        bool is_ready() const {
+            return ready;
+        }
+
+        // color already multiplied by alpha, see premultiply_alpha
+        bool is_premultiplied() const {
+            return premultiplied;
+        }
+
+        // alpha holds a signed distance, e.g. a font atlas
+        bool is_distance_field() const {
+            return distance_field;
+        }
+
+        void set_distance_field(bool value) {
+            distance_field = value;
+        }
+
+        // no texel is translucent, the renderer draws it without blending
+        bool is_opaque() const {
+            return opaque;
+        }
+
+        void set_opaque(bool value) {
+            opaque = value;
+        }
+
         // non-copyable 
         texture(const texture&) = delete;
         texture& operator=(const texture&) = delete;
 
         // movable
         texture(texture&& other) 
-            : id(other.id) 
+            : id(other.id), size(other.size), memory(other.memory), 
+              ready(other.ready.load()), premultiplied(other.premultiplied),
+              distance_field(other.distance_field), opaque(other.opaque),
+              format(other.format), levels(other.levels), 
+              loaded(other.loaded), immutable(other.immutable), 
+              sampled(other.sampled), wrap_s(other.wrap_s), 
+              wrap_t(other.wrap_t), min_filter(other.min_filter), 
+              mag_filter(other.mag_filter)
         {
             other.id = 0;
         }
@@ -81,22 +154,47 @@ export namespace tornasol {
         texture& operator=(texture&& other) 
         {
             id = other.id;
+            size = other.size;
+            memory = other.memory;
+            ready = other.ready.load();
+            premultiplied = other.premultiplied;
+            distance_field = other.distance_field;
+            opaque = other.opaque;
+            format = other.format;
+            levels = other.levels;
+            loaded = other.loaded;
+            immutable = other.immutable;
+            sampled = other.sampled;
+            wrap_s = other.wrap_s;
+            wrap_t = other.wrap_t;
+            min_filter = other.min_filter;
+            mag_filter = other.mag_filter;
             other.id = 0;
             return *this;
         }
 
-        void bind() {
+        void bind() 
+        {
+            if (!id)
+                id = gl::gen_texture();
+
             gl::bind_texture(gl::texture_2d, id);
         }
 
         void set_wrap(texture_wrap x, texture_wrap y)
         {
+            wrap_s = x;
+            wrap_t = y;
+            sampled = true;
             gl::tex_parameteri(gl::texture_2d, gl::texture_wrap_s, (gl::def)x);
             gl::tex_parameteri(gl::texture_2d, gl::texture_wrap_t, (gl::def)y);
         }
 
         void set_filter(texture_filter min, texture_filter mag)
         {
+            min_filter = min;
+            mag_filter = mag;
+            sampled = true;
             gl::tex_parameteri(gl::texture_2d, gl::texture_min_filter,
                 (gl::def)min);
             gl::tex_parameteri(gl::texture_2d, gl::texture_mag_filter,
@@ -105,6 +203,8 @@ export namespace tornasol {
 
         void load(const image& img) 
         {
+            renew();
+
             texture_format format = 
                 img.channels == 3 ? texture_format::rgb : texture_format::rgba;
 
@@ -119,11 +219,166 @@ export namespace tornasol {
                 gl::type_ubyte, 
                 img.data
             );
+
+            size = { img.width, img.height };
+            memory = img.get_size() * 4 / 3;
+            opaque = ts::is_opaque(img);
+            ready = true;
+        }
+
+        // Allocates every level of a mip chain, immutable when the context
+        // supports it. The texture is ready once the last level is loaded.
+        void allocate_levels(size2<i32> base, u32 levels, i32 channels = 4)
+        {
+            const texture_format next = 
+                channels == 3 ? texture_format::rgb : texture_format::rgba;
+            const gl::def internal = channels == 3 ? gl::rgb8 : gl::rgba8;
+
+            // immutable storage of the same shape is simply overwritten
+            const bool reuse = immutable && size == base 
+                && this->levels == levels && format == next;
+
+            if (!reuse)
+                renew();
+
+            format = next;
+            if (gl::has_tex_storage() && !reuse) {
+                gl::tex_storage_2d(gl::texture_2d, levels, internal, 
+                    base.w, base.h);
+                immutable = true;
+            }
+
+            usize bytes = 0;
+            for (u32 level = 0; level < levels; ++level)
+            {
+                size2<i32> s = get_level_size(base, level);
+                bytes += (usize)s.w * s.h * (channels == 3 ? 3 : 4);
+
+                if (!gl::has_tex_storage())
+                    gl::tex_image_2d(gl::texture_2d, level, internal, s.w, s.h,
+                        0, (gl::def)format, gl::type_ubyte, nullptr);
+            }
+
+            gl::tex_parameteri(gl::texture_2d, gl::texture_max_level, 
+                levels - 1);
+
+            size = base;
+            memory = bytes;
+            this->levels = levels;
+            loaded = 0;
+            opaque = false; // until told otherwise
+        }
+
+        // Uploads one level of the allocated chain, expects bind() first.
+        void load_level(u32 level, const byte* pixels)
+        {
+            size2<i32> s = get_level_size(size, level);
+            gl::tex_sub_image_2d(gl::texture_2d, level, 0, 0, s.w, s.h, 
+                (gl::def)format, gl::type_ubyte, pixels);
+
+            if (++loaded == levels)
+                ready = true;
+        }
+
+        // Same as load_level(level, pixels) but stages the pixels through a
+        // pixel buffer, so the transfer is done by the driver 
+        // asynchronously.
+        void load_level(u32 level, const image& img, pixel_buffer& pbo)
+        {
+            pbo.bind();
+            pbo.load(img.data, (u32)img.get_size());
+            load_level(level, nullptr); // offset into the bound buffer
+            pbo.unbind();
+        }
+
+        // Uploads an image with a mip chain downsampled on the cpu, one
+        // level at a time.
+        void load_mipmapped(const image& img)
+        {
+            const size2<i32> base = { img.width, img.height };
+            const u32 count = get_level_count(base);
+
+            allocate_levels(base, count, img.channels);
+            opaque = ts::is_opaque(img);
+            load_level(0, img.data);
+
+            image level;
+            for (u32 l = 1; l < count; ++l)
+            {
+                level = downsample(l == 1 ? img : level);
+                load_level(l, level.data);
+            }
+        }
+
+        // Uploads a complete, precomputed rgba mip chain (largest level 
+        // first, tightly packed) such as the ones stored in an asset_pack.
+        void load_levels(const byte* pixels, size2<i32> base, u32 levels,
+            bool premultiplied)
+        {
+            allocate_levels(base, levels);
+
+            usize offset = 0;
+            for (u32 level = 0; level < levels; ++level)
+            {
+                size2<i32> s = get_level_size(base, level);
+                load_level(level, pixels + offset);
+                offset += (usize)s.w * s.h * 4;
+            }
+
+            this->premultiplied = premultiplied;
+        }
+
+        // Allocates uninitialized rgba storage, e.g. to be rendered into
+        // through a framebuffer.
+        void allocate(size2<i32> size)
+        {
+            renew();
+            gl::tex_image_2d(gl::texture_2d, 0, gl::rgba8, size.w, size.h, 
+                0, gl::rgba, gl::type_ubyte, nullptr);
+
+            this->size = size;
+            memory = (usize)size.w * size.h * 4;
+            opaque = false;
+            ready = true;
         }
 
         void generate_mipmap() {
             gl::generate_mipmap(gl::texture_2d);
         }
+
+    private:
+        // Immutable storage can't be resized, a texture that gets another 
+        // image swaps it for a new name, bound in its place, with the same
+        // sampling.
+        void renew()
+        {
+            if (!immutable)
+                return;
+
+            gl::delete_texture(id);
+            id = gl::gen_texture();
+            gl::bind_texture(gl::texture_2d, id);
+            immutable = false;
+
+            if (sampled) {
+                set_wrap(wrap_s, wrap_t);
+                set_filter(min_filter, mag_filter);
+            }
+        }
+
+    public:
+        // levels of a full chain, down to 1x1
+        static u32 get_level_count(size2<i32> base)
+        {
+            u32 count = 1;
+            for (i32 s = std::max(base.w, base.h); s > 1; s /= 2)
+                ++count;
+            return count;
+        }
+
+        static size2<i32> get_level_size(size2<i32> base, u32 level) {
+            return { std::max(base.w >> level, 1), std::max(base.h >> level, 1) };
+        }
     };
 
     class texture_renderer {
@@ -131,14 +386,16 @@ export namespace tornasol {
         vertex_array  vao;
         vertex_buffer vbo;
         vertex_buffer ibo;
-        texture texture;
+        shared<ts::texture> texture;
         shader shader;
         bool wireframe;
+        bool fit; // resize the quad to the texture once it is ready
 
     public:
         texture_renderer()
             : vbo(buffer_type::vertex), ibo(buffer_type::index),
-              wireframe(false)
+              texture(std::make_shared<ts::texture>()),
+              wireframe(false), fit(false)
         {
              // default shader
             const char vertex_src[] =
@@ -187,7 +444,8 @@ export namespace tornasol {
               ibo(std::move(other.ibo)),
               texture(std::move(other.texture)), 
               shader(std::move(other.shader)),
-              wireframe(other.wireframe)
+              wireframe(other.wireframe),
+              fit(other.fit)
         {}
 
         texture_renderer& operator=(texture_renderer&& other) 
@@ -198,6 +456,7 @@ export namespace tornasol {
             texture = std::move(other.texture);
             shader = std::move(other.shader);
             wireframe = other.wireframe;
+            fit = other.fit;
             return *this;
         }
 
@@ -214,7 +473,7 @@ export namespace tornasol {
         }
 
         ts::texture& get_texture() {
-            return texture;
+            return *texture;
         }
 
         ts::shader& get_shader() {
@@ -273,12 +532,35 @@ export namespace tornasol {
 
         void set_image(const image& image) 
         {
-            texture.bind();
-            texture.set_wrap(texture_wrap::repeat, texture_wrap::repeat);
-            texture.set_filter(texture_filter::linear_mipmap_linear, 
+            texture->bind();
+            texture->set_wrap(texture_wrap::repeat, texture_wrap::repeat);
+            texture->set_filter(texture_filter::linear_mipmap_linear, 
                 texture_filter::linear);
-            texture.load(image);
-            texture.generate_mipmap();
+            texture->load_mipmapped(image);
+        }
+
+        // Shares a texture that may still be streaming in. The quad is 
+        // sized to the texture the first time it is ready.
+        void set_texture(shared<ts::texture> tex) 
+        {
+            texture = std::move(tex);
+            fit = true;
+        }
+
+        // Called by the renderer before drawing. Returns false while the
+        // texture has no pixels yet.
+        bool prepare() 
+        {
+            if (!texture->is_ready())
+                return false;
+
+            if (fit) {
+                size2<i32> size = texture->get_size();
+                set_rect({ (f32)size.w, (f32)size.h });
+                fit = false;
+            }
+
+            return true;
         }
     };
 }
\ No newline at end of file
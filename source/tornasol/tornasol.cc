@@ -27,17 +27,39 @@ export import :glfw;
 export import :stbi;
 
 // engine
+export import :arena;
+export import :assets;
 export import :buffer;
+export import :camera;
 export import :color;
+export import :command;
 export import :entity;
+export import :file;
+export import :font;
+export import :framebuffer;
+export import :image;
 export import :input;
+export import :layer_cache;
+export import :loader;
+export import :logic;
 export import :matrix;
+export import :overdraw;
+export import :pack;
+export import :pool;
+export import :profiler;
 export import :rect;
+export import :registry;
 export import :renderer;
+export import :scaler;
+export import :scheduler;
 export import :shader;
 export import :size;
+export import :spatial;
+export import :sprite;
 export import :texture;
 export import :transform;
+export import :triple_buffer;
+export import :tween;
 export import :types;
 export import :util;
 export import :vector;
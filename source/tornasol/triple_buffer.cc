@@ -0,0 +1,79 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module tornasol:triple_buffer;
+
+import :types;
+
+import <array>;
+import <atomic>;
+
+export namespace tornasol {
+
+    // Hands values from one writer thread to one reader thread without
+    // locks or waiting. The writer fills its own slot and publishes it,
+    // the reader picks up the latest published slot whenever it wants;
+    // values published in between are skipped, never torn.
+    template <typename T>
+    class triple_buffer {
+    private:
+        static constexpr u32 fresh = 4; // middle holds an unread value
+
+        std::array<T, 3> slots;
+        u32 back;                // writer's
+        u32 front;               // reader's
+        std::atomic<u32> middle; // slot index | fresh
+
+    public:
+        triple_buffer()
+            : back(0), front(1), middle(2) {}
+
+        // non-copyable
+        triple_buffer(const triple_buffer&) = delete;
+        triple_buffer& operator=(const triple_buffer&) = delete;
+
+        // writer: the slot to fill, keeps whatever it held two 
+        // publishes ago, so containers can be reused
+        T& write() {
+            return slots[back];
+        }
+
+        // writer: makes the written slot the latest
+        void publish() {
+            back = middle.exchange(back | fresh, std::memory_order_acq_rel) & 3;
+        }
+
+        // reader: switches to the latest published slot, returns false
+        // if nothing new was published since the last call
+        bool acquire()
+        {
+            if (!(middle.load(std::memory_order_relaxed) & fresh))
+                return false;
+
+            front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+            return true;
+        }
+
+        // reader: the slot acquired last
+        const T& read() const {
+            return slots[front];
+        }
+    };
+}
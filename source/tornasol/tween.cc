@@ -0,0 +1,235 @@
+/*
+    Copyright (c) 2022 Leonardo Larrad
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+       claim that you wrote the original software. If you use this software
+       in a product, an acknowledgment in the product documentation would be
+       appreciated but is not required.
+    2. Altered source versions must be plainly marked as such, and must not be
+       misrepresented as being the original software.
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+export module tornasol:tween;
+
+import :registry;
+import :texture;
+import :transform;
+import :types;
+import :vector;
+
+import <algorithm>;
+import <cmath>;
+import <vector>;
+
+export namespace tornasol {
+
+    enum class easing : u8
+    {
+        linear,
+        quad_in,
+        quad_out,
+        quad_in_out,
+        cubic_out,
+        back_out // overshoots a little, then settles
+    };
+
+    f32 ease(easing curve, f32 t)
+    {
+        switch (curve) {
+        case easing::quad_in:
+            return t * t;
+        case easing::quad_out:
+            return t * (2.0f - t);
+        case easing::quad_in_out:
+            return t < 0.5f ? 2.0f * t * t : -1.0f + (4.0f - 2.0f * t) * t;
+        case easing::cubic_out: {
+            f32 u = t - 1.0f;
+            return u * u * u + 1.0f;
+        }
+        case easing::back_out: {
+            const f32 s = 1.70158f;
+            f32 u = t - 1.0f;
+            return u * u * ((s + 1.0f) * u + s) + 1.0f;
+        }
+        default:
+            return t;
+        }
+    }
+
+    // the part of an entity's transform a tween drives
+    enum class tween_channel : u8
+    {
+        position,
+        rotation,
+        scale
+    };
+
+    // Every running tween lives in a set of parallel arrays, advanced 
+    // together once per tick: progress, then easing, then the writes into
+    // the registry. No tween is an object of its own, finished ones are 
+    // swapped out with the last.
+    class tween_system {
+    private:
+        std::vector<entity_id>       targets;
+        std::vector<tween_channel>   channels;
+        std::vector<easing>          curves;
+        std::vector<vec3<>>          from;
+        std::vector<vec3<>>          to;
+        std::vector<f32>             elapsed;
+        std::vector<f32>             delays;
+        std::vector<f32>             durations;
+        std::vector<shared<texture>> swaps; // put on the sprite at start
+        std::vector<f32>             progress; // scratch
+
+    public:
+        tween_system() = default;
+
+        // non-copyable
+        tween_system(const tween_system&) = delete;
+        tween_system& operator=(const tween_system&) = delete;
+
+        void add(entity_id target, tween_channel channel, vec3<> start, 
+            vec3<> end, f32 duration, easing curve = easing::linear, 
+            f32 delay = 0.0f, shared<texture> swap = nullptr)
+        {
+            targets.push_back(target);
+            channels.push_back(channel);
+            curves.push_back(curve);
+            from.push_back(start);
+            to.push_back(end);
+            elapsed.push_back(0.0f);
+            delays.push_back(delay);
+            durations.push_back(std::max(duration, 1e-4f));
+            swaps.push_back(std::move(swap));
+        }
+
+        // Stops the entity's tweens on a channel where they are.
+        void cancel(entity_id target, tween_channel channel)
+        {
+            for (usize i = 0; i < targets.size();)
+                if (targets[i] == target && channels[i] == channel)
+                    remove(i);
+                else
+                    ++i;
+        }
+
+        // Moves the end of the entity's tweens on a channel that have not
+        // started yet, they keep their delay. False if there are none.
+        bool retarget(entity_id target, tween_channel channel, vec3<> end)
+        {
+            bool found = false;
+            for (usize i = 0; i < targets.size(); ++i)
+                if (targets[i] == target && channels[i] == channel 
+                    && elapsed[i] < delays[i])
+                {
+                    to[i] = end;
+                    found = true;
+                }
+
+            return found;
+        }
+
+        // Stops all of the entity's tweens where they are.
+        void cancel(entity_id target)
+        {
+            for (usize i = 0; i < targets.size();)
+                if (targets[i] == target)
+                    remove(i);
+                else
+                    ++i;
+        }
+
+        bool is_active(entity_id target) const {
+            return std::find(targets.begin(), targets.end(), target) 
+                != targets.end();
+        }
+
+        bool empty() const {
+            return targets.empty();
+        }
+
+        usize get_size() const {
+            return targets.size();
+        }
+
+        void update(registry& reg, f32 dt)
+        {
+            const usize n = targets.size();
+            progress.resize(n);
+
+            for (usize i = 0; i < n; ++i)
+            {
+                elapsed[i] += dt;
+                f32 t = (elapsed[i] - delays[i]) / durations[i];
+                progress[i] = std::clamp(t, 0.0f, 1.0f);
+            }
+
+            for (usize i = 0; i < n; ++i)
+                progress[i] = ease(curves[i], progress[i]);
+
+            for (usize i = 0; i < n; ++i)
+            {
+                if (elapsed[i] < delays[i] || !reg.is_alive(targets[i]))
+                    continue;
+
+                if (swaps[i])
+                    reg.get_sprite(targets[i]).texture = std::move(swaps[i]);
+
+                f32 p = progress[i];
+                vec3<> v = from[i] + (to[i] - from[i]) * p;
+                ts::transform& t = reg.get_transform(targets[i]);
+
+                switch (channels[i]) {
+                case tween_channel::position: t.pos = v; break;
+                case tween_channel::rotation: t.rot = v; break;
+                case tween_channel::scale:    t.sca = v; break;
+                }
+            }
+
+            for (usize i = 0; i < targets.size();)
+                if (elapsed[i] >= delays[i] + durations[i] 
+                    || !reg.is_alive(targets[i]))
+                    remove(i);
+                else
+                    ++i;
+        }
+
+    private:
+        void remove(usize i)
+        {
+            usize last = targets.size() - 1;
+
+            if (i != last)
+            {
+                targets[i] = targets[last];
+                channels[i] = channels[last];
+                curves[i] = curves[last];
+                from[i] = from[last];
+                to[i] = to[last];
+                elapsed[i] = elapsed[last];
+                delays[i] = delays[last];
+                durations[i] = durations[last];
+                swaps[i] = std::move(swaps[last]);
+            }
+
+            targets.pop_back();
+            channels.pop_back();
+            curves.pop_back();
+            from.pop_back();
+            to.pop_back();
+            elapsed.pop_back();
+            delays.pop_back();
+            durations.pop_back();
+            swaps.pop_back();
+        }
+    };
+}
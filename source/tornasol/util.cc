@@ -21,6 +21,9 @@
 export module tornasol:util;
 
 import <iostream>;
+import <iterator>;
+import <memory_resource>;
+import <string>;
 import <string_view>;
 import <format>;
 import <utility>;
@@ -30,8 +33,15 @@ export namespace tornasol {
     template <typename ... A>
     void print(std::string_view fmt, A&& ...args)
     {
-        std::cout 
-            << std::vformat(fmt, std::make_format_args(std::forward<A>(args)...)) 
-            << std::endl;
+        // formatted on the stack, long messages spill to the heap; print 
+        // runs on threads that never reset a frame arena
+        char buffer[512];
+        std::pmr::monotonic_buffer_resource memory(buffer, sizeof(buffer));
+        std::pmr::string out(&memory);
+        out.reserve(sizeof(buffer) / 2);
+        std::vformat_to(std::back_inserter(out), fmt, 
+            std::make_format_args(std::forward<A>(args)...));
+
+        std::cout << out << std::endl;
     }
 }
\ No newline at end of file
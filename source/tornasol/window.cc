@@ -27,13 +27,30 @@ import :types;
 import :vector;
 
 import <functional>;
+import <stdexcept>;
+import <string>;
 import <string_view>;
 
 export namespace tornasol {
 
+    // Only the context differs. glfw still opens its platform display 
+    // for every backend, so headless machines need a virtual one, e.g. 
+    // Xvfb; osmesa then renders on the cpu, without a gpu.
+    enum class window_backend
+    {
+        native, // platform window and context
+        egl,    // never shown, egl context
+        osmesa  // never shown, software context, needs no gpu
+    };
+
     class window {
     private:
         glfw::window_handle handle;
+        window_backend backend;
+        u64 events;
+        vec2<> cursor_scale;  // applied to cursor positions
+        vec2<> cursor_offset;
+        input_queue input_events;
 
     public:
         std::function<void(vec2<i32>)>     on_move;
@@ -56,7 +73,10 @@ export namespace tornasol {
         std::function<void(u32, key_mod)>  on_char_mods;
         std::function<void(size2<>)>       on_framebuffer_resize;
 
-        window(std::string_view title, size2<> size, bool resizable = true)
+        window(std::string_view title, size2<> size, bool resizable = true,
+            window_backend backend = window_backend::native, u32 samples = 4)
+            : backend(backend), events(0), cursor_scale(1.0f, 1.0f), 
+              cursor_offset(0.0f, 0.0f)
         {
             glfw::window_hint(glfw::attribute::context_ver_major, 4);
             glfw::window_hint(glfw::attribute::context_ver_minor, 0);
@@ -64,11 +84,29 @@ export namespace tornasol {
                 (int) glfw::gl_profile::core);
             glfw::window_hint(glfw::attribute::visible, false);
             glfw::window_hint(glfw::attribute::resizable, resizable);
-            glfw::window_hint(glfw::attribute::samples, 4);
+            glfw::window_hint(glfw::attribute::samples, (int) samples);
+
+            if (backend == window_backend::egl)
+                glfw::window_hint(glfw::attribute::context_creation_api,
+                    (int) glfw::context_api::egl);
+            else if (backend == window_backend::osmesa)
+                glfw::window_hint(glfw::attribute::context_creation_api,
+                    (int) glfw::context_api::osmesa);
 
             handle = glfw::create_window(size.w, size.h,
                 title.data(), nullptr, nullptr);
 
+            if (!handle)
+            {
+                const char* desc = nullptr;
+                glfw::get_error(&desc);
+                throw std::runtime_error(
+                    std::string("failed to create window: ") 
+                    + (desc ? desc : "unknown error") 
+                    + (backend == window_backend::native ? "" 
+                        : ", headless backends still need a display"));
+            }
+
             glfw::set_window_user_pointer(handle, this);
             glfw::set_window_pos_callback(handle, move_callback);
             glfw::set_window_size_callback(handle, resize_callback);
@@ -99,8 +137,30 @@ export namespace tornasol {
             return handle;
         }
 
-        void show() {
-            glfw::show_window(handle);
+        // filled by the callbacks, drained by input::update
+        input_queue& get_input_queue() {
+            return input_events;
+        }
+
+        // bumped by every callback, tells whether anything happened 
+        // since the last look
+        u64 get_event_count() const {
+            return events;
+        }
+
+        window_backend get_backend() const {
+            return backend;
+        }
+
+        // headless windows are never shown, rendering goes offscreen
+        bool is_headless() const {
+            return backend != window_backend::native;
+        }
+
+        void show() 
+        {
+            if (!is_headless())
+                glfw::show_window(handle);
         }
 
         void hide() {
@@ -150,6 +210,22 @@ export namespace tornasol {
             glfw::set_window_size(handle, size.w, size.h);
         }
 
+        // in pixels, larger than get_size() on high dpi screens
+        size2<> get_framebuffer_size() const {
+            size2<> size;
+            glfw::get_window_framebuffer_size(handle, &size.w, &size.h);
+            return size;
+        }
+
+        // Maps cursor positions before they are reported, scale first, 
+        // e.g. into a renderer's design coordinates. Set it from the thread
+        // pulling events.
+        void set_cursor_mapping(vec2<> scale, vec2<> offset) 
+        {
+            cursor_scale = scale;
+            cursor_offset = offset;
+        }
+
         bool key_pressed(key key)
         {
             return glfw::get_key(handle, key) 
@@ -194,10 +270,23 @@ export namespace tornasol {
         }
 
     private:
+        static window* from_handle(glfw::window_handle handle)
+        {
+            auto* self = (window*)glfw::get_window_user_pointer(handle);
+            ++self->events;
+            return self;
+        }
+
+        void push_input(input_event e) 
+        {
+            e.time = glfw::get_time();
+            input_events.push(e);
+        }
+
         static void move_callback(glfw::window_handle handle,
             i32 x, i32 y)
         {
-            auto* self = (window*)glfw::get_window_user_pointer(handle);
+            auto* self = from_handle(handle);
             if (self->on_move)
                 self->on_move({ x, y });
         }
@@ -205,28 +294,28 @@ export namespace tornasol {
         static void resize_callback(glfw::window_handle handle,
             i32 w, i32 h)
         {
-            auto* self = (window*)glfw::get_window_user_pointer(handle);
+            auto* self = from_handle(handle);
             if (self->on_resize)
                 self->on_resize({ w, h });
         }
 
         static void close_callback(glfw::window_handle handle)
         {
-            auto* self = (window*)glfw::get_window_user_pointer(handle);
+            auto* self = from_handle(handle);
             if (self->on_close)
                 self->on_close();
         }
 
         static void minimize_callback(glfw::window_handle handle, i32 min)
         {
-            auto* self = (window*)glfw::get_window_user_pointer(handle);
+            auto* self = from_handle(handle);
             if (self->on_minimize)
                 self->on_minimize();
         }
 
         static void maximize_callback(glfw::window_handle handle, i32 max)
         {
-            auto* self = (window*)glfw::get_window_user_pointer(handle);
+            auto* self = from_handle(handle);
             if (self->on_maximize)
                 self->on_maximize();
         }
@@ -234,7 +323,7 @@ export namespace tornasol {
         static void focus_callback(glfw::window_handle handle,
             i32 focused)
         {
-            auto* self = (window*)glfw::get_window_user_pointer(handle);            
+            auto* self = from_handle(handle);
             if (focused) 
                 if (self->on_focus) self->on_focus();
             else
@@ -243,22 +332,29 @@ export namespace tornasol {
 
         static void refresh_callback(glfw::window_handle handle)
         {
-            auto* self = (window*)glfw::get_window_user_pointer(handle);
+            auto* self = from_handle(handle);
             if (self->on_refresh) self->on_refresh();
         }
 
         static void cursor_move_callback(glfw::window_handle handle,
             f64 x, f64 y)
         {
-            auto* self = (window*)glfw::get_window_user_pointer(handle);
+            auto* self = from_handle(handle);
+            vec2<> pos = { 
+                (f32)x * self->cursor_scale.x + self->cursor_offset.x,
+                (f32)y * self->cursor_scale.y + self->cursor_offset.y 
+            };
+
+            self->push_input({ input_event_type::cursor, {}, 0, pos });
+
             if (self->on_cursor_move)
-                self->on_cursor_move({ (f32)x, (f32)y });
+                self->on_cursor_move(pos);
         }
 
         static void cursor_enter_callback(glfw::window_handle handle,
             int entered)
         {
-            auto* self = (window*)glfw::get_window_user_pointer(handle);
+            auto* self = from_handle(handle);
             if (entered)
                 if (self->on_cursor_enter) self->on_cursor_enter();
             else
@@ -268,14 +364,20 @@ export namespace tornasol {
         static void scroll_callback(glfw::window_handle handle,
             f64 x, f64 y)
         {
-            auto* self = (window*)glfw::get_window_user_pointer(handle);
+            auto* self = from_handle(handle);
+            self->push_input({ input_event_type::scroll, {}, 0, 
+                { (f32)x, (f32)y } });
+
             if (self->on_scroll) self->on_scroll({ (f32)x, (f32)y });
         }
 
         static void mouse_button_callback(glfw::window_handle handle,
             i32 button, i32 action, i32 mods)
         {
-            auto* self = (window*)glfw::get_window_user_pointer(handle);
+            auto* self = from_handle(handle);
+            self->push_input({ input_event_type::button, 
+                (glfw::input_action)action, button });
+
             if (self->on_mouse_button)
                 self->on_mouse_button(
                     (mouse_button)button, (mouse_action)action, (key_mod)mods
@@ -285,7 +387,10 @@ export namespace tornasol {
         static void key_callback(glfw::window_handle handle,
             i32 keycode, i32 scancode, i32 action, i32 mods)
         {
-            auto* self = (window*)glfw::get_window_user_pointer(handle);
+            auto* self = from_handle(handle);
+            self->push_input({ input_event_type::key, 
+                (glfw::input_action)action, keycode });
+
             if (self->on_key)
                 self->on_key(
                     (key)keycode, scancode, (key_action)action, (key_mod)mods
@@ -295,14 +400,14 @@ export namespace tornasol {
         static void char_callback(glfw::window_handle handle,
             u32 codepoint)
         {
-            auto* self = (window*)glfw::get_window_user_pointer(handle);
+            auto* self = from_handle(handle);
             if (self->on_char) self->on_char(codepoint);
         }
 
         static void char_mods_callback(glfw::window_handle handle,
             u32 codepoint, i32 mods)
         {
-            auto* self = (window*)glfw::get_window_user_pointer(handle);
+            auto* self = from_handle(handle);
             if (self->on_char_mods)
                 self->on_char_mods(codepoint, (key_mod)mods);
         }
@@ -310,7 +415,7 @@ export namespace tornasol {
         static void framebuffer_resize_callback(glfw::window_handle handle,
             i32 w, i32 h)
         {
-            auto* self = (window*)glfw::get_window_user_pointer(handle);
+            auto* self = from_handle(handle);
             if (self->on_framebuffer_resize)
                 self->on_framebuffer_resize({ w, h });
         }